@@ -0,0 +1,86 @@
+#include <te/sim.hpp>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdio>
+
+namespace {
+    // Most entities have a site, three quarters of them trade and two thirds of those have an
+    // inventory, added in a shuffled order so the pools don't line up by themselves.
+    void populate(entt::registry& registry, std::size_t n) {
+        std::default_random_engine rengine { 1234 };
+        std::vector<entt::entity> traders;
+        for (std::size_t i = 0; i < n; i++) {
+            const auto entity = registry.create();
+            registry.assign<te::site>(entity, glm::vec2{static_cast<float>(i % 1000), static_cast<float>(i / 1000)});
+            if (i % 4 != 0) {
+                te::trader trader { static_cast<unsigned>(i % 3) };
+                trader.bid[0] = static_cast<double>(i % 7) - 3.0;
+                registry.assign<te::trader>(entity, trader);
+                traders.push_back(entity);
+            }
+        }
+        std::shuffle(traders.begin(), traders.end(), rengine);
+        for (std::size_t i = 0; i < traders.size(); i++) {
+            if (i % 3 != 0) {
+                te::inventory inventory;
+                inventory.stock[0] = static_cast<int>(i % 5);
+                registry.assign<te::inventory>(traders[i], inventory);
+            }
+        }
+    }
+
+    template<typename F>
+    double time_per_entity(std::size_t n, F&& run) {
+        const int repeats = static_cast<int>(std::max<std::size_t>(1, 10000000 / n));
+        double total = 0.0;
+        auto then = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            total += run();
+        }
+        std::chrono::duration<double> secs = std::chrono::high_resolution_clock::now() - then;
+        // keeps the work from being optimised away
+        if (total == 0.123) std::printf("\n");
+        return secs.count() * 1e9 / (static_cast<double>(n) * repeats);
+    }
+}
+
+// Iterate traders with their inventories, through a view over the two pools and through
+// a group owning both like the sim's, and report the cost per entity of each.
+int main() {
+    for (std::size_t n = 10000; n <= 1000000; n *= 10) {
+        entt::registry viewed;
+        populate(viewed, n);
+        entt::registry grouped;
+        grouped.group<te::trader, te::inventory>();
+        populate(grouped, n);
+
+        const double view_ns = time_per_entity(n, [&]() {
+            double total = 0.0;
+            viewed.view<te::trader, te::inventory>().each (
+                [&](const auto& trader, const auto& inventory) {
+                    total += trader.bid[0] * inventory.stock[0];
+                }
+            );
+            return total;
+        });
+        const double group_ns = time_per_entity(n, [&]() {
+            double total = 0.0;
+            grouped.group<te::trader, te::inventory>().each (
+                [&](const auto& trader, const auto& inventory) {
+                    total += trader.bid[0] * inventory.stock[0];
+                }
+            );
+            return total;
+        });
+        std::printf (
+            "%8zu entities: view %7.2f ns/entity, group %7.2f ns/entity (%.2fx)\n",
+            n,
+            view_ns,
+            group_ns,
+            view_ns / group_ns
+        );
+    }
+    return 0;
+}
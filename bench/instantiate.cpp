@@ -0,0 +1,49 @@
+#include "lattice.hpp"
+#include <te/sim.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+    std::size_t memberships(te::sim& model) {
+        std::size_t total = 0;
+        for (auto market_e : model.entities.view<te::market, te::site>()) {
+            total += model.members_of(market_e).size();
+        }
+        return total;
+    }
+}
+
+// Build the same markets and fields one at a time with try_place and in two batches with
+// instantiate_many, and report how long each took.
+int main(const int argc, const char** argv) {
+    const std::size_t fields = argc > 1 ? std::stoul(argv[1]) : 100000;
+    const int map_size = te_bench::lattice_map_size(fields * 2);
+    const auto plan = te_bench::lay_out(map_size, fields);
+
+    const auto one_by_one = te_bench::empty_world(map_size);
+    const auto market_blueprint = one_by_one->blueprints[3];
+    const auto field_blueprint = one_by_one->blueprints[0];
+    auto then = std::chrono::high_resolution_clock::now();
+    for (auto centre : plan.markets) one_by_one->try_place(market_blueprint, centre);
+    for (auto centre : plan.fields) one_by_one->try_place(field_blueprint, centre);
+    std::chrono::duration<double> single_secs = std::chrono::high_resolution_clock::now() - then;
+
+    const auto batched = te_bench::empty_world(map_size);
+    then = std::chrono::high_resolution_clock::now();
+    batched->instantiate_many(batched->blueprints[3], plan.markets);
+    batched->instantiate_many(batched->blueprints[0], plan.fields);
+    std::chrono::duration<double> batch_secs = std::chrono::high_resolution_clock::now() - then;
+
+    std::printf (
+        "%zu markets and %zu fields on a %dx%d map\n"
+        "  try_place:        %8.3f s, %zu entities, %zu memberships\n"
+        "  instantiate_many: %8.3f s, %zu entities, %zu memberships\n",
+        plan.markets.size(), plan.fields.size(), map_size, map_size,
+        single_secs.count(), static_cast<std::size_t>(one_by_one->entities.alive()), memberships(*one_by_one),
+        batch_secs.count(), static_cast<std::size_t>(batched->entities.alive()), memberships(*batched)
+    );
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef TE_BENCH_LATTICE_HPP_INCLUDED
+#define TE_BENCH_LATTICE_HPP_INCLUDED
+
+#include <te/sim.hpp>
+#include <memory>
+#include <vector>
+
+// A world for benchmarks to fill: a lattice of 2x2 buildings a cell apart, with a market every
+// so often, on a map with nothing generated on it.
+namespace te_bench {
+    struct lattice {
+        std::vector<glm::vec2> markets;
+        std::vector<glm::vec2> fields;
+    };
+
+    // the smallest map, doubling from 64 cells across, with room for this many lattice sites
+    inline int lattice_map_size(std::size_t sites) {
+        int map_size = 64;
+        while (static_cast<std::size_t>(map_size / 3) * (map_size / 3) < sites) map_size *= 2;
+        return map_size;
+    }
+
+    // centres of every market on the map and of up to max_fields fields, row by row
+    inline lattice lay_out(int map_size, std::size_t max_fields) {
+        lattice out;
+        const int half = map_size / 2;
+        for (int y = -half + 1; y + 1 < half; y += 3) {
+            for (int x = -half + 1; x + 1 < half; x += 3) {
+                const bool market_here = (x + half) % 24 == 1 && (y + half) % 24 == 1;
+                if (market_here) {
+                    out.markets.push_back(glm::vec2{x, y});
+                } else if (out.fields.size() < max_fields) {
+                    out.fields.push_back(glm::vec2{x, y});
+                }
+            }
+        }
+        return out;
+    }
+
+    inline std::unique_ptr<te::sim> empty_world(int map_size) {
+        te::world_params params;
+        params.map_width = map_size;
+        params.map_height = map_size;
+        params.buildings = 0;
+        params.threads = 1;
+        return std::make_unique<te::sim>(1, params);
+    }
+}
+
+#endif
@@ -0,0 +1,46 @@
+#include <te/order_book.hpp>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdio>
+
+// Fill and match a single book with n traders and report the cost per trader.
+// Near-constant ns/trader as n grows means matching scales (near-)linearly.
+int main() {
+    std::default_random_engine rengine { 1234 };
+    std::uniform_real_distribution<double> select_bid { -10.0, 10.0 };
+    for (std::size_t n = 1000; n <= 1000000; n *= 10) {
+        std::vector<double> bids(n);
+        std::vector<int> stock(n);
+        for (std::size_t i = 0; i < n; i++) {
+            bids[i] = select_bid(rengine);
+            stock[i] = bids[i] < 0.0 ? static_cast<int>(-bids[i]) : 0;
+        }
+        te::order_book book;
+        const int repeats = static_cast<int>(std::max<std::size_t>(1, 1000000 / n));
+        long traded = 0;
+        auto then = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            book.clear();
+            for (std::size_t i = 0; i < n; i++) {
+                book.add(static_cast<entt::entity>(i), bids[i]);
+            }
+            book.match (
+                [&](entt::entity, entt::entity seller, int movement) {
+                    if (stock[static_cast<std::size_t>(seller)] < movement) return 0;
+                    traded += movement;
+                    return movement;
+                }
+            );
+        }
+        std::chrono::duration<double> secs = std::chrono::high_resolution_clock::now() - then;
+        std::printf (
+            "%8zu traders: %10.3f ms/match, %7.2f ns/trader (%ld units traded)\n",
+            n,
+            secs.count() * 1000.0 / repeats,
+            secs.count() * 1e9 / (static_cast<double>(n) * repeats),
+            traded / repeats
+        );
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <te/site_index.hpp>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    struct placed {
+        entt::entity entity;
+        glm::vec2 position;
+    };
+
+    template<typename F>
+    double seconds_per_query(int queries, F&& query) {
+        std::size_t found = 0;
+        auto then = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < queries; i++) found += query(i);
+        std::chrono::duration<double> secs = std::chrono::high_resolution_clock::now() - then;
+        // keeps the work from being optimised away
+        if (found == 123456789) std::printf("\n");
+        return secs.count() / queries;
+    }
+}
+
+// Scatter entities over a map and time finding what's within a click of a point, within a
+// market's radius and inside a drag box, through the index and by looking at every entity.
+int main() {
+    for (std::size_t n = 10000; n <= 1000000; n *= 10) {
+        const int map_size = 4096;
+        std::default_random_engine rengine { 1234 };
+        std::uniform_real_distribution<float> coordinate { -map_size / 2.0f, map_size / 2.0f };
+        std::vector<placed> all;
+        te::site_index index { map_size, map_size, 4.0f };
+        for (std::size_t i = 0; i < n; i++) {
+            const placed one { static_cast<entt::entity>(i), glm::vec2{coordinate(rengine), coordinate(rengine)} };
+            all.push_back(one);
+            index.insert(one.entity, one.position);
+        }
+        std::vector<glm::vec2> points;
+        for (int i = 0; i < 1000; i++) points.push_back(glm::vec2{coordinate(rengine), coordinate(rengine)});
+
+        auto scan = [&](glm::vec2 min, glm::vec2 max) {
+            std::size_t found = 0;
+            for (const auto& one : all) {
+                found += one.position.x >= min.x && one.position.y >= min.y && one.position.x <= max.x && one.position.y <= max.y;
+            }
+            return found;
+        };
+        auto indexed = [&](glm::vec2 min, glm::vec2 max) {
+            std::size_t found = 0;
+            index.each_in_rect(min, max, [&](entt::entity, glm::vec2) { found++; });
+            return found;
+        };
+        for (float half : {1.0f, 5.0f, 50.0f}) {
+            const int queries = static_cast<int>(points.size());
+            const double scan_secs = seconds_per_query(queries, [&](int i) { return scan(points[i] - half, points[i] + half); });
+            const double index_secs = seconds_per_query(queries, [&](int i) { return indexed(points[i] - half, points[i] + half); });
+            std::printf (
+                "%8zu entities, %5.0f wide: scan %10.2f us, index %8.3f us (%.0fx)\n",
+                n,
+                half * 2.0f,
+                scan_secs * 1e6,
+                index_secs * 1e6,
+                scan_secs / index_secs
+            );
+        }
+    }
+    return 0;
+}
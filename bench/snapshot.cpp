@@ -0,0 +1,52 @@
+#include "lattice.hpp"
+#include <te/sim.hpp>
+#include <te/snapshot.hpp>
+#include <te/state_hash.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    // fields and markets, each market with its commons, making up about this many entities
+    std::unique_ptr<te::sim> populated(std::size_t entities) {
+        const int map_size = te_bench::lattice_map_size(entities);
+        auto plan = te_bench::lay_out(map_size, entities);
+        plan.fields.resize(std::min(plan.fields.size(), entities - std::min(entities, plan.markets.size() * 2)));
+        auto model = te_bench::empty_world(map_size);
+        model->instantiate_many(model->blueprints[3], plan.markets);
+        model->instantiate_many(model->blueprints[0], plan.fields);
+        return model;
+    }
+}
+
+// Save a world of about a million entities and load it again, reporting how long each took
+// and whether what was loaded hashes the same as what was saved.
+int main(const int argc, const char** argv) {
+    const std::size_t entities = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    const std::string filename = argc > 2 ? argv[2] : "bench_snapshot.bin";
+    const auto model = populated(entities);
+    for (int i = 0; i < 10; i++) model->tick(0.25);
+
+    auto then = std::chrono::high_resolution_clock::now();
+    te::save_snapshot(*model, filename);
+    std::chrono::duration<double> save_secs = std::chrono::high_resolution_clock::now() - then;
+
+    then = std::chrono::high_resolution_clock::now();
+    const auto loaded = te::load_snapshot(filename, 1);
+    std::chrono::duration<double> load_secs = std::chrono::high_resolution_clock::now() - then;
+
+    const bool same = te::state_hash(*model) == te::state_hash(*loaded);
+    std::printf (
+        "%zu entities: save %.3f s, load %.3f s, %s\n",
+        static_cast<std::size_t>(model->entities.alive()),
+        save_secs.count(),
+        load_secs.count(),
+        same ? "state matches" : "STATE DIFFERS"
+    );
+    std::remove(filename.c_str());
+    return same ? 0 : 1;
+}
@@ -1,6 +1,8 @@
 #ifndef TE_APP_HPP_INCLUDED
 #define TE_APP_HPP_INCLUDED
 #include <te/sim.hpp>
+#include <te/command_log.hpp>
+#include <te/render_components.hpp>
 #include <te/window.hpp>
 #include <te/cache.hpp>
 #include <te/camera.hpp>
@@ -8,13 +10,17 @@
 #include <te/mesh_renderer.hpp>
 #include <te/colour_picker.hpp>
 #include <te/util.hpp>
+#include <te/step_clock.hpp>
 #include <unordered_map>
+#include <vector>
 #include <random>
 #include <imgui.h>
 #include <glm/glm.hpp>
 namespace te {
     struct app {
         te::sim& model;
+        // where commands are recorded, if the session is being recorded
+        te::command_log* log;
         std::default_random_engine rengine;
         te::glfw_context glfw;
         te::window win;
@@ -25,15 +31,42 @@ namespace te {
         te::colour_picker colour_picker;
         te::asset_loader loader;
         te::cache<asset_loader> resources;
+        te::step_clock clock;
+
+        // game seconds the fast-forward button runs for
+        double fast_forward_for = 3600.0;
+        // game seconds of fast-forward still to run, and how many to run each frame
+        double fast_forward_left = 0.0;
+        double fast_forward_slice = 0.0;
+        std::optional<te::advance_report> fast_forward_progress;
+
+        bool show_profiler = false;
+
+        // markets away from the camera and the inspector tick once every lod_stride ticks; off to
+        // start with, as a market coming into focus catches up all it put off in one tick
+        bool lod_enabled = false;
+        int lod_stride = 8;
+        float lod_radius = 48.0f;
 
         std::optional<entt::entity> inspected;
+        // what was picked out by dragging a box over the map, in entity order
+        std::vector<entt::entity> selected;
+        // where on the map a drag with the left button started
+        std::optional<glm::vec2> drag_from;
         std::optional<entt::entity> ghost;
+        // whether the ghost could be placed where it is now
+        bool ghost_placeable = false;
         entt::entity marker;
 
-        app(te::sim& model, unsigned int seed);
+        app(te::sim& model, unsigned int seed, te::command_log* log = nullptr);
+
+        // everything that changes the model goes through here, so it can be recorded
+        std::optional<entt::entity> issue(const te::command& cmd);
 
         void on_key(int key, int scancode, int action, int mods);
         void on_mouse_button(int button, int action, int mods);
+        // select every pickable entity in the rectangle with corners a and b
+        void select_box(glm::vec2 a, glm::vec2 b);
 
         std::optional<glm::vec2> pos_under_mouse;
         void mouse_pick();
@@ -41,10 +74,15 @@ namespace te {
         
         void render_scene();
         void render_inspector();
+        void render_profiler();
         void render_controller();
         void render_ui();
 
+        // tick through the next slice of a fast-forward without rendering in between
+        void fast_forward();
         void input();
+        // keep the sim's level of detail centred on what's on screen
+        void follow_focus();
         void draw();
         void run();
     };
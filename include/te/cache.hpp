@@ -5,9 +5,11 @@
 #include <type_traits>
 #include <te/util.hpp>
 #include <te/unique_any.hpp>
+#include <te/interner.hpp>
 #include <te/util.hpp>
 #include <te/mesh.hpp>
 #include <utility>
+#include <vector>
 #include <spdlog/spdlog.h>
 namespace te {
     struct asset_loader {
@@ -19,6 +21,8 @@ namespace te {
     template<typename F>
     class cache {
         std::unordered_map<std::string, unique_any> loaded;
+        // what has been loaded for each interned name, so those are found by indexing
+        std::vector<unique_any*> by_id;
         F& loader;
     public:
         cache(F& loader) : loader(loader) {
@@ -57,6 +61,18 @@ namespace te {
                 return loaded_it->second.template get<T>();
             }
         }
+
+        template<typename T>
+        T& lazy_load(string_id filename) {
+            if (filename.index < by_id.size() && by_id[filename.index]) {
+                return by_id[filename.index]->template get<T>();
+            }
+            if (filename.index >= by_id.size()) by_id.resize(filename.index + 1, nullptr);
+            T& resource = lazy_load<T>(str(filename));
+            // nodes of an unordered_map stay put as it grows
+            by_id[filename.index] = &loaded.find(str(filename))->second;
+            return resource;
+        }
     };
 }
 #endif
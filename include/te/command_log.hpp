@@ -0,0 +1,87 @@
+#ifndef TE_COMMAND_LOG_HPP_INCLUDED
+#define TE_COMMAND_LOG_HPP_INCLUDED
+
+#include <te/sim.hpp>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+#include <glm/vec2.hpp>
+
+namespace te {
+    // Everything that changes a sim from outside, so that a session can be recorded and re-run.
+    // Commands refer to blueprints by index and to the ghost as the one the player is holding,
+    // never by entity, so they mean the same thing after a sim has been saved and loaded.
+
+    // count ticks of dt game seconds each
+    struct tick_command {
+        double dt;
+        std::uint32_t count = 1;
+    };
+
+    // start holding a ghost of a blueprint that's for sale
+    struct pick_up_command {
+        std::uint32_t blueprint_ix;
+    };
+
+    struct move_ghost_command {
+        glm::vec2 where;
+    };
+
+    // build the held ghost where it stands, paid for by a family
+    struct place_ghost_command {
+        std::uint32_t family_ix;
+    };
+
+    // change the sim's level of detail, as the player looks around
+    struct focus_command {
+        lod_policy policy;
+    };
+
+    using command = std::variant<tick_command, pick_up_command, move_ghost_command, place_ghost_command, focus_command>;
+
+    // the ghost being held, if any; there is at most one
+    std::optional<entt::entity> held_ghost(sim& model);
+    // carry out a command, returning the ghost picked up or the building placed, if there was one
+    std::optional<entt::entity> apply(sim& model, const command& cmd);
+
+    constexpr std::uint32_t command_log_version = 2;
+
+    struct command_log_error : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    // A session as recorded: the world it started from and what was done to it.
+    struct recorded_session {
+        unsigned seed;
+        world_params params;
+        std::vector<command> commands;
+        // ticks in the whole session
+        long ticks() const;
+    };
+
+    // Append-only record of a session, written as it is played. Runs of ticks of the same length
+    // are merged into one record, held back until something else happens or the run gets long.
+    class command_log {
+        std::ofstream file;
+        std::optional<tick_command> pending_ticks;
+        void write(const command& cmd);
+    public:
+        // start a log for a session on a sim freshly made from seed and params
+        command_log(const std::string& filename, unsigned seed, const world_params& params);
+        command_log(const command_log&) = delete;
+        ~command_log();
+
+        void record(const command& cmd);
+        // write out any ticks held back
+        void flush();
+    };
+
+    // A log cut short, by a crash say, is read up to its last whole record.
+    recorded_session read_command_log(const std::string& filename);
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef TE_INTERNER_HPP_INCLUDED
+#define TE_INTERNER_HPP_INCLUDED
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace te {
+    // A small handle to a string kept by the interner, for strings that many entities share such
+    // as asset paths and names. Handles compare, sort and hash as integers; two handles are equal
+    // exactly when their strings are. The order is that of interning, not of the strings.
+    struct string_id {
+        std::uint32_t index = 0;
+
+        bool operator==(string_id other) const {
+            return index == other.index;
+        }
+        bool operator!=(string_id other) const {
+            return index != other.index;
+        }
+        bool operator<(string_id other) const {
+            return index < other.index;
+        }
+    };
+
+    // Strings are kept for the life of the process, so handles stay valid and what str() returns
+    // never moves. The empty string is always handle 0. Safe to use from any thread, though it is
+    // meant for loading and placing things rather than for the tick.
+    class string_interner {
+        mutable std::mutex lock;
+        // a deque doesn't move what it holds as it grows, so the keys can view into it
+        std::deque<std::string> strings;
+        std::unordered_map<std::string_view, string_id> ids;
+    public:
+        string_interner();
+        string_interner(const string_interner&) = delete;
+
+        string_id intern(std::string_view s);
+        const std::string& str(string_id id) const;
+        std::size_t size() const;
+    };
+
+    // the interner for the whole process
+    string_interner& interned_strings();
+
+    inline string_id intern(std::string_view s) {
+        return interned_strings().intern(s);
+    }
+    inline const std::string& str(string_id id) {
+        return interned_strings().str(id);
+    }
+}
+
+namespace std {
+    template<>
+    struct hash<te::string_id> {
+        std::size_t operator()(te::string_id id) const {
+            return std::hash<std::uint32_t>{}(id.index);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef TE_MERCHANT_LANES_HPP_INCLUDED
+#define TE_MERCHANT_LANES_HPP_INCLUDED
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <entt/entt.hpp>
+
+namespace te {
+    // Merchant movement state packed into parallel arrays, one lane per merchant, so that
+    // moving every travelling merchant is a single pass the compiler can vectorise.
+    // Positions here are authoritative while a merchant travels and are copied out to its site.
+    struct merchant_lanes {
+        // merchants this close to their destination have arrived
+        static constexpr float arrival_distance = 1.0f;
+
+        std::vector<entt::entity> merchants;
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> destination_x;
+        std::vector<float> destination_y;
+        // cells per game second
+        std::vector<float> speed;
+        // how far the merchant can go before it could enter or leave a market's radius;
+        // negative once it needs its membership re-evaluated
+        std::vector<float> slack;
+        // set by advance: 1 if the merchant was already at its destination and didn't move
+        std::vector<std::uint8_t> arrived;
+
+        std::size_t size() const;
+        void clear();
+        void push_back(entt::entity merchant, float x, float y, float destination_x, float destination_y, float speed);
+        // whether the lanes are for exactly these merchants, in this order
+        bool matches(const entt::entity* merchants, std::size_t count) const;
+
+        // move every merchant not yet at its destination up to speed * dt towards it
+        void advance(float dt);
+    };
+}
+
+#endif
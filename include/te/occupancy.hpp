@@ -0,0 +1,107 @@
+#ifndef TE_OCCUPANCY_HPP_INCLUDED
+#define TE_OCCUPANCY_HPP_INCLUDED
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <cstdint>
+#include <optional>
+#include <glm/glm.hpp>
+#include <entt/entt.hpp>
+
+namespace te {
+    // Occupancy layer for a width x height map centred on the origin.
+    // Cells are addressed by their integer world-space top-left corner.
+    // The map is split into chunk_size x chunk_size chunks which are only allocated once something is
+    // placed in them, so memory follows the built-up area rather than the size of the map.
+    // Each chunk keeps one bit per cell saying whether it is taken, with the owning entity alongside,
+    // and answers rectangle queries through a summed-area table of the bits.
+    // Queries don't change anything, so any number of threads may ask at once while none is placing.
+    class occupancy_grid {
+    public:
+        static constexpr int chunk_size = 64;
+    private:
+        struct rect {
+            glm::ivec2 topleft;
+            glm::ivec2 dimensions;
+        };
+        // fills and clears tolerated on top of a chunk's table before it is rebuilt
+        static constexpr std::size_t max_pending = 16;
+
+        struct chunk {
+            // one word per row, bit x for column x
+            std::array<std::uint64_t, chunk_size> rows {};
+            std::array<entt::entity, chunk_size * chunk_size> owners;
+            // (chunk_size + 1)^2 counts of taken cells above and to the left, as of the last rebuild;
+            // fills and clears since then are checked separately
+            std::array<std::uint16_t, (chunk_size + 1) * (chunk_size + 1)> taken_before {};
+            std::vector<rect> pending_fills;
+            std::vector<rect> pending_clears;
+
+            chunk();
+            void rebuild();
+            // rebuilds once too much is pending for queries to stay quick
+            void note(std::vector<rect>& pending, glm::ivec2 local, glm::ivec2 dimensions);
+            // whether any of a rectangle inside the chunk, in chunk coordinates, is taken
+            bool any_taken(glm::ivec2 local, glm::ivec2 dimensions) const;
+            void fill(glm::ivec2 local, glm::ivec2 dimensions, entt::entity owner);
+            void clear(glm::ivec2 local, glm::ivec2 dimensions);
+        };
+
+        int width;
+        int height;
+        glm::ivec2 origin;
+        glm::ivec2 chunk_counts;
+        std::vector<std::unique_ptr<chunk>> chunks;
+
+        // calls f(chunk index, rectangle within that chunk in chunk coordinates) for each chunk a
+        // rectangle on the map, in map coordinates, overlaps
+        template<typename F>
+        void each_chunk(glm::ivec2 local, glm::ivec2 dimensions, F&& f) const {
+            const glm::ivec2 first = local / chunk_size;
+            const glm::ivec2 last = (local + dimensions - 1) / chunk_size;
+            for (int cy = first.y; cy <= last.y; cy++) {
+                for (int cx = first.x; cx <= last.x; cx++) {
+                    const glm::ivec2 chunk_topleft = glm::ivec2{cx, cy} * chunk_size;
+                    const glm::ivec2 begin = glm::max(local, chunk_topleft);
+                    const glm::ivec2 end = glm::min(local + dimensions, chunk_topleft + chunk_size);
+                    if (!f(static_cast<std::size_t>(cy) * chunk_counts.x + cx, begin - chunk_topleft, end - begin)) {
+                        return;
+                    }
+                }
+            }
+        }
+    public:
+        occupancy_grid(int width, int height);
+
+        // whether the rectangle lies entirely on the map
+        bool contains(glm::ivec2 topleft, glm::ivec2 dimensions) const;
+        // whether the rectangle lies on the map and none of it is taken
+        bool is_free(glm::ivec2 topleft, glm::ivec2 dimensions) const;
+        // calls visit(topleft) for every free placement of a dimensions-sized rectangle with its
+        // top-left corner in [min, max], row by row
+        template<typename F>
+        void each_free(glm::ivec2 dimensions, glm::ivec2 min, glm::ivec2 max, F&& visit) const {
+            min = glm::max(min, origin);
+            max = glm::min(max, origin + glm::ivec2{width, height} - dimensions);
+            for (int y = min.y; y <= max.y; y++) {
+                for (int x = min.x; x <= max.x; x++) {
+                    if (is_free({x, y}, dimensions)) visit(glm::ivec2{x, y});
+                }
+            }
+        }
+        void fill(glm::ivec2 topleft, glm::ivec2 dimensions, entt::entity owner);
+        void clear(glm::ivec2 topleft, glm::ivec2 dimensions);
+        std::optional<entt::entity> at(glm::ivec2 cell) const;
+
+        // chunks allocated so far, out of chunk_count()
+        std::size_t allocated_chunks() const;
+        std::size_t chunk_count() const;
+        // owners of every cell of a chunk, row by row, or nullptr if it hasn't been allocated
+        const entt::entity* chunk_owners(std::size_t chunk_ix) const;
+        // replace a chunk's contents with owners laid out as chunk_owners gives them
+        void restore_chunk(std::size_t chunk_ix, const entt::entity* owners);
+    };
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef TE_ORDER_BOOK_HPP_INCLUDED
+#define TE_ORDER_BOOK_HPP_INCLUDED
+
+#include <vector>
+#include <algorithm>
+#include <entt/entt.hpp>
+
+namespace te {
+    // Outstanding orders for one commodity in one market.
+    // Everything trades at the market price, so orders only differ by quantity.
+    struct order_book {
+        struct order {
+            entt::entity trader;
+            double quantity;
+        };
+        // both sides hold +ve quantities, largest first once sorted
+        std::vector<order> bids;
+        std::vector<order> asks;
+
+        void clear();
+        // +ve bid = buying, -ve bid = selling, as in te::trader
+        void add(entt::entity trader, double bid);
+        void sort();
+
+        // Pair off the book in a single pass.
+        // settle(buyer, seller, movement) performs the trade and returns how many
+        // units actually changed hands; 0 passes over the seller (e.g. if short of stock).
+        template<typename F>
+        void match(F&& settle) {
+            sort();
+            auto bid_it = bids.begin();
+            auto ask_it = asks.begin();
+            while (bid_it != bids.end() && ask_it != asks.end()) {
+                const auto movement = static_cast<int>(std::min(bid_it->quantity, ask_it->quantity));
+                if (movement == 0) {
+                    // only whole units trade; drop whichever side is a fraction
+                    if (bid_it->quantity < ask_it->quantity) {
+                        bid_it++;
+                    } else {
+                        ask_it++;
+                    }
+                    continue;
+                }
+                const int moved = settle(bid_it->trader, ask_it->trader, movement);
+                if (moved <= 0) {
+                    // seller can't deliver anything
+                    ask_it++;
+                    continue;
+                }
+                bid_it->quantity -= moved;
+                ask_it->quantity -= moved;
+                if (bid_it->quantity < 1.0) bid_it++;
+                if (ask_it->quantity < 1.0) ask_it++;
+            }
+        }
+    };
+}
+
+#endif
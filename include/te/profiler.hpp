@@ -0,0 +1,92 @@
+#ifndef TE_PROFILER_HPP_INCLUDED
+#define TE_PROFILER_HPP_INCLUDED
+
+#include <array>
+#include <chrono>
+#include <vector>
+#include <iosfwd>
+#include <entt/entt.hpp>
+
+namespace te {
+    enum class tick_phase : std::size_t {
+        merchants,
+        generators,
+        producers,
+        demanders,
+        matching,
+        pricing,
+        growth,
+        dwellings
+    };
+    constexpr std::size_t tick_phase_count = 8;
+    const char* phase_name(tick_phase phase);
+
+    // seconds spent in each phase
+    using phase_times = std::array<double, tick_phase_count>;
+
+    // Adds its own lifetime to a phase's total.
+    class phase_timer {
+        double& total;
+        std::chrono::steady_clock::time_point start;
+    public:
+        phase_timer(phase_times& times, tick_phase phase) :
+            total { times[static_cast<std::size_t>(phase)] },
+            start { std::chrono::steady_clock::now() }
+        {
+        }
+        phase_timer(const phase_timer&) = delete;
+        ~phase_timer() {
+            total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    struct market_profile {
+        entt::entity market;
+        std::size_t members;
+        phase_times times;
+    };
+
+    // Where the time went in one tick. Market phases are summed over markets, and so over
+    // threads when markets tick in parallel; seconds is the wall time of the whole tick.
+    struct tick_profile {
+        long tick;
+        double dt;
+        double seconds;
+        // merchants travelling, not those waiting at a stop
+        std::size_t merchants;
+        phase_times times;
+        // in the order the markets ticked
+        std::vector<market_profile> markets;
+    };
+
+    // The profiles of the last so many ticks, kept in a ring. Slots are reused as it wraps,
+    // so recording a tick once it's full doesn't allocate.
+    class tick_history {
+        std::vector<tick_profile> slots;
+        std::size_t capacity_ = 0;
+        std::size_t next = 0;
+        std::size_t count = 0;
+    public:
+        explicit tick_history(std::size_t capacity = 0);
+
+        // forgets every tick recorded so far
+        void set_capacity(std::size_t capacity);
+        std::size_t capacity() const;
+        std::size_t size() const;
+        void clear();
+        // oldest first
+        const tick_profile& operator[](std::size_t i) const;
+        const tick_profile& latest() const;
+        // the slot to record the next tick in, in place of the oldest once full;
+        // null if the capacity is 0
+        tick_profile* record();
+    };
+
+    // one object per tick, with one per market inside it
+    void write_profile_json(std::ostream& out, const tick_history& history);
+    // one row per market per tick, after a row for the whole tick with market -1 and
+    // the merchants travelling in place of members
+    void write_profile_csv(std::ostream& out, const tick_history& history);
+}
+
+#endif
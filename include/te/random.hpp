@@ -0,0 +1,60 @@
+#ifndef TE_RANDOM_HPP_INCLUDED
+#define TE_RANDOM_HPP_INCLUDED
+
+#include <cstdint>
+#include <limits>
+
+namespace te {
+    // what a run of random numbers is for, so that different uses never share one; the values go
+    // into keys, so changing one changes what's drawn
+    enum class random_stream : std::uint32_t {
+        dwellings = 2
+    };
+
+    // A counter-based generator after Widynski's Squares: the nth number drawn is a function of the
+    // key and n alone, and the key is hashed from the world seed, the tick, an identifier of
+    // whatever is drawing and a stream. Each draws the same numbers however work is split between
+    // threads or ordered, with no state to share or save.
+    // Meets UniformRandomBitGenerator, so it works with the standard distributions.
+    class counter_rng {
+        std::uint64_t key;
+        std::uint64_t counter = 0;
+
+        static constexpr std::uint64_t rotate(std::uint64_t x) {
+            return (x >> 32) | (x << 32);
+        }
+    public:
+        using result_type = std::uint32_t;
+
+        // splitmix64's finaliser, also for anything else that needs a hash that's the same everywhere
+        static constexpr std::uint64_t mix(std::uint64_t x) {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            return x ^ (x >> 31);
+        }
+
+        counter_rng(std::uint64_t seed, std::uint64_t tick, std::uint64_t id, random_stream stream) :
+            // squares wants an odd key
+            key { mix(mix(mix(mix(seed) ^ tick) ^ id) ^ static_cast<std::uint64_t>(stream)) | 1 }
+        {
+        }
+
+        static constexpr result_type min() {
+            return 0;
+        }
+        static constexpr result_type max() {
+            return std::numeric_limits<result_type>::max();
+        }
+        result_type operator()() {
+            std::uint64_t x = counter++ * key;
+            const std::uint64_t y = x;
+            const std::uint64_t z = y + key;
+            x = rotate(x * x + y);
+            x = rotate(x * x + z);
+            x = rotate(x * x + y);
+            return static_cast<result_type>((x * x + z) >> 32);
+        }
+    };
+}
+
+#endif
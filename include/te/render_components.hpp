@@ -0,0 +1,20 @@
+#ifndef TE_RENDER_COMPONENTS_HPP_INCLUDED
+#define TE_RENDER_COMPONENTS_HPP_INCLUDED
+
+#include <te/interner.hpp>
+
+namespace te {
+    // Client Components
+    // Plain data naming the assets an entity is drawn with; the simulation
+    // assigns them to blueprints but never looks at them.
+    struct render_tex {
+        string_id filename;
+    };
+    struct render_mesh {
+        string_id filename;
+    };
+    struct pickable {
+    };
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef TE_REPLAY_HPP_INCLUDED
+#define TE_REPLAY_HPP_INCLUDED
+
+#include <te/command_log.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace te {
+    // Re-runs a recorded session as fast as it will go. Every keyframe_interval ticks the state
+    // is saved as a snapshot in keyframe_dir, and a seek starts from the last keyframe before
+    // where it's going rather than from the beginning. Keyframes are listed in an index in
+    // keyframe_dir, so a later replay of the same session starts from those already there.
+    class replay {
+        // where in the session a sim stands: ticks_done of commands[next_command] have been done
+        struct cursor {
+            std::size_t next_command = 0;
+            std::uint32_t ticks_done = 0;
+            // of the commands before next_command, to tell whether a keyframe on disk is from this session
+            std::uint64_t digest = 0;
+        };
+        struct keyframe {
+            long tick;
+            replay::cursor cursor;
+            std::string filename;
+        };
+
+        recorded_session session;
+        std::string keyframe_dir;
+        long keyframe_interval;
+        std::size_t threads;
+        long total_ticks;
+        std::unique_ptr<sim> current;
+        cursor at;
+        // in order of tick
+        std::vector<keyframe> keyframes;
+
+        void restart();
+        void swap_in(std::unique_ptr<sim> next);
+        void save_keyframe();
+        void read_keyframes();
+        void write_keyframes() const;
+    public:
+        // Called when a seek swaps in another sim, a keyframe or a fresh start, with the one being
+        // thrown away; carries over whatever was set up on it from outside, such as a journal.
+        std::function<void(sim& old_model, sim& new_model)> on_swap;
+
+        // a keyframe_interval of 0 saves no keyframes
+        replay(recorded_session session, std::string keyframe_dir, long keyframe_interval, std::size_t threads = 0);
+
+        sim& model();
+        const recorded_session& recorded() const;
+        long tick() const;
+        // carry out the next command, or the next tick of a run of them; false at the end of the session
+        bool step();
+        // move to just after the given tick, before anything done between it and the next;
+        // seeking to the last tick or beyond goes to the very end of the session
+        void seek(long tick);
+    };
+}
+
+#endif
@@ -2,21 +2,61 @@
 #define TE_SIM_HPP_INCLUDED
 
 #include <te/util.hpp>
+#include <te/order_book.hpp>
+#include <te/occupancy.hpp>
+#include <te/site_index.hpp>
+#include <te/worker_pool.hpp>
+#include <te/profiler.hpp>
+#include <te/worldgen.hpp>
+#include <te/merchant_lanes.hpp>
+#include <te/work_schedule.hpp>
+#include <te/trade_journal.hpp>
+#include <te/random.hpp>
+#include <te/interner.hpp>
 #include <unordered_map>
 #include <vector>
+#include <array>
+#include <cstdint>
 #include <random>
 #include <string>
+#include <memory>
+#include <functional>
 #include <glm/vec2.hpp>
 #include <entt/entt.hpp>
 
 namespace te {
+    // Commodities are numbered 0..commodities.size() by init_blueprints, so per-commodity
+    // state can be stored inline in components rather than in hash maps.
+    constexpr std::size_t max_commodities = 8;
+
+    template<typename T>
+    struct alignas(32) per_commodity {
+        std::array<T, max_commodities> values {};
+
+        T& operator[](std::size_t commodity) {
+            return values[commodity];
+        }
+        const T& operator[](std::size_t commodity) const {
+            return values[commodity];
+        }
+        auto begin() { return values.begin(); }
+        auto end() { return values.end(); }
+        auto begin() const { return values.begin(); }
+        auto end() const { return values.end(); }
+        bool operator==(const per_commodity&) const = default;
+    };
+
     struct family {
         double balance;
     };
 
     struct named {
-        std::string name;
+        string_id name;
+        // instances share their blueprint's name, and have their entity put after it when shown
+        bool numbered = false;
     };
+    // what to call a named entity on screen, formatted when asked
+    std::string display_name(entt::entity entity, const named& the_named);
 
     struct price {
         double price;
@@ -41,7 +81,7 @@ namespace te {
 
     // A demander stores the rate of increase of demand of entities
     struct demander {
-        std::unordered_map<entt::entity, double> rate;
+        per_commodity<double> rate;
     };
 
     // A trader stores the current demand of entities
@@ -50,41 +90,75 @@ namespace te {
         unsigned int family_ix;
         // +ve bid = buying
         // -ve bid = selling
-        std::unordered_map<entt::entity, double> bid;
+        per_commodity<double> bid;
         double balance = 0.0;
     };
 
+    // Generators and producers don't advance every tick. Each has a game time its current piece of
+    // work is due, and its market's schedule picks it up when that time comes. One with nothing
+    // to do has no due time and costs nothing until a trade changes its inventory.
+
     struct generator {
-        entt::entity output;
+        std::size_t output;
         double rate;
-        double progress = 0.0;
+        // when the next unit will be made; none while full
+        std::optional<double> due;
     };
 
     struct producer {
-        std::unordered_map<entt::entity, double> inputs;
-        std::unordered_map<entt::entity, double> outputs;
+        per_commodity<double> inputs;
+        per_commodity<double> outputs;
         double rate;
         bool producing = false;
-        double progress = 0.0;
+        // when the current batch will be finished, or when to check for inputs again
+        std::optional<double> due;
     };
 
     struct inventory {
-        std::unordered_map<entt::entity, int> stock;
+        per_commodity<int> stock;
     };
 
     struct market {
-        std::unordered_map<entt::entity, double> prices;
-        std::unordered_map<entt::entity, double> demand;
+        per_commodity<double> prices;
+        // units wanted by member traders, to the nearest hundredth
+        per_commodity<double> demand;
         entt::entity commons;
         double radius = 5.0f;
+        // member dwellings
         int population = 0;
         double growth_rate = 0.001;
         double growth = 0.0;
+        // game seconds since the market last ticked, while level of detail is putting it off
+        double pending = 0.0;
+        // Running totals over member traders, kept in step as bids and membership change.
+        // Demand is counted in whole hundredths so adding and removing bids can't drift.
+        per_commodity<std::int64_t> demand_hundredths;
+        // units offered for sale by member traders
+        per_commodity<double> supply;
+        // summed rates of member demanders
+        per_commodity<double> demand_rate;
+        // Member traders that may be able to trade each commodity. Every member that can is
+        // here, along with some that couldn't when they last came up to be matched, which are
+        // dropped then. Changing a member's bid wakes it for that commodity, and stock only
+        // ever arrives along with a bid change, so a trader with nothing to buy or sell sleeps.
+        per_commodity<std::vector<entt::entity>> awake;
+        // scratch space for matching, reused for each commodity
+        order_book orders;
+        // member generators and producers by when they are next due
+        work_schedule generator_schedule;
+        work_schedule producer_schedule;
+
+        // change a member trader's bid, updating the totals
+        void adjust_bid(std::size_t commodity, double old_bid, double new_bid);
+        void set_bid(entt::entity member_e, trader& member, std::size_t commodity, double bid);
+        void wake_trader(entt::entity member_e, std::size_t commodity);
+        void add_trader(entt::entity member_e, const trader& member);
+        void remove_trader(const trader& member);
     };
 
     struct stop {
         entt::entity where;
-        std::unordered_map<entt::entity, int> leave_with;
+        per_commodity<int> leave_with;
     };
 
     struct route {
@@ -96,58 +170,237 @@ namespace te {
         std::optional<te::route> route;
         std::size_t last_stop = 0;
         bool trading = false;
+        // cells per game second
+        float speed = 1.0f;
+    };
+
+    // Changes to state shared between markets, recorded while a market ticks and
+    // applied once every market has ticked, in market order, so that results don't
+    // depend on how many threads ticked them.
+    struct market_effects {
+        std::vector<double> family_balances;
+        phase_times times;
+        // largest change in any of the market's prices, relative to the base price
+        double price_change;
+        // the trades settled, kept only while there's a journal
+        std::vector<trade> trades;
+    };
+
+    // A summary of the whole economy at one moment.
+    struct economy_metrics {
+        double time;
+        long ticks;
+        std::size_t markets;
+        long population;
+        double mean_growth_rate;
+        // averaged over markets, for the first commodities commodities
+        std::size_t commodities;
+        per_commodity<double> mean_prices;
+        std::vector<double> family_balances;
+    };
+
+    struct advance_report {
+        // game seconds done so far, out of game_seconds
+        double elapsed;
+        double game_seconds;
+        long ticks;
+        // length of the latest tick
+        double step;
+        double real_seconds;
+    };
+
+    struct advance_options {
+        // Ticks may be lengthened up to this many game seconds while prices are settled, that is while
+        // no price moved by more than tolerance of its base in the last tick, and are shortened
+        // again as soon as they aren't. No longer than the step it's given means no coarsening.
+        double max_step = 0.0;
+        double tolerance = 0.001;
+        // report is called every report_interval game seconds, and at the end
+        double report_interval = 0.0;
+        std::function<void(const advance_report&)> report;
+        // called after every tick with its length, for recording
+        std::function<void(double)> on_tick;
+    };
+
+    // The sim's level of detail. Markets reaching within radius of the focus, or with inspected in
+    // them, tick every step; the rest tick every stride steps, staggered, with all the game time
+    // since they last did. Generators and producers work to their schedules in game time, so they
+    // catch up exactly; demand, prices and growth move in proportion to the time passed. A market
+    // coming into focus takes its pending time on its next step.
+    struct lod_policy {
+        std::optional<glm::vec2> focus;
+        float radius = 64.0f;
+        std::optional<glm::vec2> inspected;
+        // 1 ticks every market every step
+        std::uint32_t stride = 1;
+
+        bool operator==(const lod_policy& other) const {
+            return focus == other.focus && radius == other.radius && inspected == other.inspected && stride == other.stride;
+        }
+        bool operator!=(const lod_policy& other) const {
+            return !(*this == other);
+        }
+    };
+
+    // market ticks taken and put off by level of detail, since construction
+    struct lod_counts {
+        long ticked = 0;
+        long deferred = 0;
+    };
+
+    struct world_params {
+        int map_width = 40;
+        int map_height = 40;
+        int buildings = 100;
+        // generation plans tiles of this many cells square independently, in parallel
+        int tile_size = 64;
+        // cells kept clear around each generated building
+        int spacing = 1;
+        // see sim::set_threads
+        std::size_t threads = 0;
+        // false leaves the map empty, without even blueprints, for a snapshot to be loaded into
+        bool generate = true;
     };
 
     struct sim {
-        std::default_random_engine rengine;
+        const unsigned seed;
         
         entt::registry entities;
         std::vector<family> families;
+        // indexed by commodity number
         std::vector<entt::entity> commodities;
         std::vector<entt::entity> blueprints;
         std::vector<route> routes;
-        entt::entity merchant_blueprint;
+        entt::entity merchant_blueprint = entt::null;
 
-        const int map_width = 40;
-        const int map_height = 40;
-        std::unordered_map<glm::ivec2, entt::entity> grid;
+        // fixed at construction from world_params
+        const int map_width;
+        const int map_height;
+        occupancy_grid grid { map_width, map_height };
+        // Every entity with a site, and those that are also markets, kept up to date through the
+        // registry's signals; a site's position must be replaced rather than written for them to hear.
+        site_index sites { map_width, map_height, 4.0f };
+        site_index market_sites { map_width, map_height, 16.0f };
+        // the largest radius of any market indexed since the last clear, for searching market_sites
+        double widest_market = 0.0;
         glm::vec2 snap(glm::vec2 pos, glm::vec2 print) const;
 
-        sim(unsigned seed);
+        sim(unsigned seed, world_params params = {});
+        // the registry's signals call back into the sim
+        sim(const sim&) = delete;
 
+        // remove every entity along with everything that refers to them, leaving an empty map
+        void clear();
         void init_blueprints();
-        void generate_map();
+        void generate_map(int buildings, int tile_size, int spacing);
 
         // which entities a market has influence over
         std::unordered_map<entt::entity, std::vector<entt::entity>> market_influencees;
         // which markets an entity is influenced by
         std::unordered_map<entt::entity, std::vector<entt::entity>> influencee_markets;
+        const std::vector<entt::entity>& members_of(entt::entity market_e) const;
+        bool is_member(entt::entity market_e, entt::entity entity) const;
+        void add_member(entt::entity market_e, entt::entity entity);
+        void remove_member(entt::entity market_e, entt::entity entity);
+        void recount_demand_rate(entt::entity market_e);
+        // change a bid outside of tick_market, updating the totals of whichever markets the trader is in
+        void set_bid(entt::entity trader_e, std::size_t commodity, double bid);
+        // entity must have a site; markets also take in everything within their radius
+        void join_markets(entt::entity entity);
+        void leave_markets(entt::entity entity);
+        // re-evaluate membership after an entity has moved, returning how much further it
+        // could move before it might enter or leave a market
+        float update_markets(entt::entity entity);
+        void demolish(entt::entity entity);
 
         // total units wanting to be sold
-        int market_stock(entt::entity market_e, entt::entity commodity_e);
-        int market_demand(entt::entity market_e, entt::entity commodity_e);
+        int market_stock(entt::entity market_e, std::size_t commodity);
+        double market_demand(entt::entity market_e, std::size_t commodity);
 
         market* market_at(glm::vec2 x);
         bool in_market(const site& question_site, const site& market_site, const market& the_market) const;
 
         bool can_place(entt::entity entity, glm::vec2 where);
         std::optional<entt::entity> try_place(entt::entity entity, glm::vec2 where);
+        // Place proto at each of centres where it fits, in order, skipping those it doesn't, whether
+        // because of what's already built or an earlier centre in the batch; returns what was placed.
+        // Components are copied from proto a pool at a time and market membership is worked out once
+        // for the whole batch, so this is much quicker than try_place for many buildings at once.
+        std::vector<entt::entity> instantiate_many(entt::entity proto, const std::vector<glm::vec2>& centres);
+        // every centre within radius of around at which proto can be placed
+        std::vector<glm::vec2> placements(entt::entity proto, glm::vec2 around, float radius);
+        // a random one of placements(), tried by a few random probes before enumerating them all
+        std::optional<glm::vec2> sample_placement(counter_rng& rng, entt::entity proto, glm::vec2 around, float radius, int probes = 5);
+
+        // Numbers drawn for a market this tick. Markets are told apart by where they stand, which
+        // unlike their entities stays the same when a sim is saved and loaded.
+        counter_rng market_rng(entt::entity market, random_stream stream);
+        bool spawn_dwelling(entt::entity market, counter_rng& rng);
         
-        bool spawn_dwelling(entt::entity market);
-        void spawn(entt::entity proto);
-        
+        // markets tick on a pool of this many threads; 0 or 1 ticks them on the caller
+        void set_threads(std::size_t threads);
+
+        // running totals since construction
+        long ticks = 0;
+        // game seconds
+        double time = 0.0;
+        phase_times tick_times {};
+        // per-tick and per-market timings over the last few hundred ticks
+        tick_history profile { 600 };
+        // where trades are journalled once markets have settled, if anywhere
+        std::unique_ptr<trade_journal> journal;
+
+        lod_policy lod;
+        lod_counts lod_work;
+        // whether the policy has a market tick every step, rather than every stride steps
+        bool at_full_detail(const site& market_site, const market& the_market) const;
+
+        // set by tick: the largest relative change in any price, over the last tick
+        double price_change = 0.0;
+        economy_metrics measure();
+
+        // tick back to back until game_seconds have passed, returning the ticks taken
+        long advance(double game_seconds, double step, const advance_options& options = {});
+
+        // how far through its current unit or batch a building is, from 0 to 1
+        double progress(const generator& the_generator) const;
+        double progress(const producer& the_producer) const;
+
         void tick(double delta_t);
-    };
+        void move_merchants(double delta_t);
+        void tick_market(entt::entity market_e, double delta_t, market_effects& effects);
+        // apply a market's effects, then spawn and demolish its dwellings, timing that into the effects;
+        // tick adds the effects' times to the totals
+        void settle_market(entt::entity market_e, market_effects& effects);
+    private:
+        // Traders and their inventories are owned by a group so that they're packed in the same
+        // order, for matching. Nothing else may own either of them, or sort their pools.
+        void declare_groups();
+        // keep sites and market_sites up to date as sites and markets come, go and move
+        void watch_sites();
+        void site_added(entt::registry& registry, entt::entity entity, site& the_site);
+        void site_replaced(entt::registry& registry, entt::entity entity, site& the_site);
+        void site_removed(entt::registry& registry, entt::entity entity);
+        void market_added(entt::registry& registry, entt::entity entity, market& the_market);
+        void market_removed(entt::registry& registry, entt::entity entity);
+        void settle_dwellings(entt::entity market_e);
+        // create proto at centre, unchecked and without joining any markets
+        entt::entity instantiate(entt::entity proto, glm::vec2 centre);
+        // put a member building with nothing due back on its market's schedule, if a change to
+        // its inventory means it can get on: a full generator has sold some, an idle producer has
+        // all its inputs
+        void wake(market& the_market, entt::entity building);
 
-    //TOOD: put these somewhere else
-    // Client Components
-    struct render_tex {
-        std::string filename;
-    };
-    struct render_mesh {
-        std::string filename;
-    };
-    struct pickable {
+        // One lane per merchant, in the order of the merchant pool, laid out again whenever the
+        // pool's entities change. A merchant's route and speed are read when it sets off for a stop.
+        merchant_lanes lanes;
+        void lay_out_lanes();
+
+        std::unique_ptr<worker_pool> workers;
+        std::vector<entt::entity> tick_markets;
+        // game seconds each of tick_markets is ticked for
+        std::vector<double> tick_dts;
+        std::vector<market_effects> tick_effects;
     };
 }
 
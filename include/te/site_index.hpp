@@ -0,0 +1,93 @@
+#ifndef TE_SITE_INDEX_HPP_INCLUDED
+#define TE_SITE_INDEX_HPP_INCLUDED
+
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <glm/glm.hpp>
+#include <entt/entt.hpp>
+
+namespace te {
+    // Where entities stand on a width x height map centred on the origin, bucketed into a uniform
+    // grid of square cells, so that what is near a point, in a circle or in a rectangle is found by
+    // looking through a few cells rather than at every entity. Positions off the map are kept in
+    // the nearest cell on its edge.
+    // Each entity's cell and slot are kept by entity index, so an entity can be moved or removed
+    // without knowing where it was, and removal swaps the last entry of its cell into the gap.
+    class site_index {
+        struct entry {
+            entt::entity entity;
+            glm::vec2 position;
+        };
+        struct place {
+            std::uint32_t cell;
+            std::uint32_t slot;
+        };
+        static constexpr std::uint32_t nowhere = ~std::uint32_t{0};
+
+        float cell_size;
+        glm::vec2 origin;
+        glm::ivec2 cell_counts;
+        std::vector<std::vector<entry>> cells;
+        std::vector<place> places;
+        std::size_t count = 0;
+
+        static std::size_t index_of(entt::entity entity);
+        glm::ivec2 cell_at(glm::vec2 position) const;
+        std::uint32_t cell_ix(glm::ivec2 cell) const {
+            return static_cast<std::uint32_t>(cell.y * cell_counts.x + cell.x);
+        }
+        void unlink(place at);
+    public:
+        site_index(int width, int height, float cell_size);
+
+        // adds the entity, or moves it if it's already here
+        void insert(entt::entity entity, glm::vec2 position);
+        void move(entt::entity entity, glm::vec2 position);
+        // does nothing if the entity isn't here
+        void erase(entt::entity entity);
+        bool contains(entt::entity entity) const;
+        std::size_t size() const;
+        void clear();
+
+        // calls visit(entity, position) for everything in the rectangle from min to max, edges included
+        template<typename F>
+        void each_in_rect(glm::vec2 min, glm::vec2 max, F&& visit) const {
+            const glm::ivec2 first = cell_at(min);
+            const glm::ivec2 last = cell_at(max);
+            for (int y = first.y; y <= last.y; y++) {
+                for (int x = first.x; x <= last.x; x++) {
+                    for (const auto& the_entry : cells[cell_ix({x, y})]) {
+                        const auto position = the_entry.position;
+                        if (position.x >= min.x && position.y >= min.y && position.x <= max.x && position.y <= max.y) {
+                            visit(the_entry.entity, position);
+                        }
+                    }
+                }
+            }
+        }
+        // calls visit(entity, position) for everything no further than radius from centre
+        template<typename F>
+        void each_within(glm::vec2 centre, float radius, F&& visit) const {
+            each_in_rect(centre - radius, centre + radius, [&](entt::entity entity, glm::vec2 position) {
+                if (glm::length(position - centre) <= radius) visit(entity, position);
+            });
+        }
+        // the nearest entity no further than radius from point for which accept(entity) holds
+        template<typename F>
+        std::optional<entt::entity> nearest(glm::vec2 point, float radius, F&& accept) const {
+            std::optional<entt::entity> found;
+            float found_distance = radius;
+            each_within(point, radius, [&](entt::entity entity, glm::vec2 position) {
+                const float distance = glm::length(position - point);
+                if ((!found || distance < found_distance) && accept(entity)) {
+                    found = entity;
+                    found_distance = distance;
+                }
+            });
+            return found;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef TE_SNAPSHOT_HPP_INCLUDED
+#define TE_SNAPSHOT_HPP_INCLUDED
+
+#include <te/sim.hpp>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace te {
+    // Binary snapshots of a whole sim: the registry, families, routes, level of detail and occupancy.
+    // Each component pool is written as a column of entities followed by a column of components,
+    // aligned so that a load can map the file and copy columns straight out of it.
+    // Interned strings are written once each, in a table ahead of the components that use them.
+    // Market membership and what is derived from it, the market totals and work schedules, are saved as
+    // membership lists and rebuilt.
+    // Snapshots are only read back by the same version of the format, on the same architecture.
+    constexpr std::uint32_t snapshot_version = 7;
+
+    struct snapshot_error : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    void save_snapshot(sim& model, const std::string& filename);
+    // threads as for sim::set_threads
+    std::unique_ptr<sim> load_snapshot(const std::string& filename, std::size_t threads = 0);
+}
+
+#endif
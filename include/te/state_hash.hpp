@@ -0,0 +1,16 @@
+#ifndef TE_STATE_HASH_HPP_INCLUDED
+#define TE_STATE_HASH_HPP_INCLUDED
+
+#include <te/sim.hpp>
+#include <cstdint>
+
+namespace te {
+    // A hash of everything that decides how the sim goes on from here: its entities and their
+    // components, market membership and each market's schedules, in the order they'll be run.
+    // Two sims with the same hash tick the same way, so runs that ought to agree, such as one
+    // continued from a snapshot and one that wasn't, can be checked against each other.
+    // Timings, the profile and anything else the sim only reports on are left out.
+    std::uint64_t state_hash(sim& model);
+}
+
+#endif
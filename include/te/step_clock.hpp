@@ -0,0 +1,34 @@
+#ifndef TE_STEP_CLOCK_HPP_INCLUDED
+#define TE_STEP_CLOCK_HPP_INCLUDED
+
+namespace te {
+    // Turns elapsed real time into a whole number of fixed-size simulation steps,
+    // so the cost and accuracy of a tick don't depend on the frame rate.
+    struct step_clock {
+        // simulation steps per game second
+        double tick_rate = 4.0;
+        // game seconds per real second
+        double speed = 3.0;
+        // most steps taken for a single call to advance; any time owed beyond that is
+        // dropped, so one slow frame can't snowball into ever longer catch-up frames
+        int max_catch_up = 8;
+        bool paused = false;
+
+        // game seconds each step simulates
+        double step() const;
+        // how many steps to take now that real_seconds have passed since the last call
+        int advance(double real_seconds);
+        // take exactly one step on the next advance, even while paused
+        void step_once();
+        // fraction of a step owed but not yet simulated
+        double lag() const;
+        // total steps given up to the catch-up limit
+        long dropped() const;
+    private:
+        double accumulator = 0.0;
+        int queued = 0;
+        long dropped_steps = 0;
+    };
+}
+
+#endif
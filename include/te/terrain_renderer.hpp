@@ -4,13 +4,16 @@
 #include <glad/glad.h>
 #include <te/camera.hpp>
 #include <te/gl.hpp>
-#include <random>
+#include <te/util.hpp>
+#include <unordered_map>
 #include <glm/glm.hpp>
 
 namespace te {
+    // Draws the ground as chunk_size x chunk_size blocks of tiles, each built the first time the camera
+    // comes near it. Tiles are picked by hashing their position with the seed, so a chunk looks the
+    // same however and whenever it is built.
     class terrain_renderer {
         gl::context& gl;
-        gl::buffer<GL_ARRAY_BUFFER> vbo;
         gl::program program;
         GLint model_uniform;
         GLint view_uniform;
@@ -18,11 +21,22 @@ namespace te {
         gl::sampler sampler;
         gl::texture<GL_TEXTURE_2D> texture;
         GLuint vao;
+        GLint pos_attrib;
+        GLint col_attrib;
+        GLint tex_attrib;
+        unsigned seed;
+        // keyed by chunk coordinates, i.e. grid position / chunk_size
+        std::unordered_map<glm::ivec2, gl::buffer<GL_ARRAY_BUFFER>> chunks;
+
+        gl::buffer<GL_ARRAY_BUFFER>& chunk_at(glm::ivec2 chunk);
+        // number of tiles of a chunk which lie on the map
+        glm::ivec2 chunk_extent(glm::ivec2 chunk) const;
     public:
+        static constexpr int chunk_size = 64;
         const int width;
         const int height;
         const glm::vec3 grid_topleft;
-        terrain_renderer(gl::context& gl, std::default_random_engine& rengine, int width, int height);
+        terrain_renderer(gl::context& gl, unsigned seed, int width, int height);
         void render(const te::camera& cam);
     };
 }
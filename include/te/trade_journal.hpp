@@ -0,0 +1,85 @@
+#ifndef TE_TRADE_JOURNAL_HPP_INCLUDED
+#define TE_TRADE_JOURNAL_HPP_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <entt/entt.hpp>
+
+namespace te {
+    // one settled trade: quantity units of a commodity bought by buyer from seller
+    struct trade {
+        std::int64_t tick;
+        entt::entity market;
+        std::uint32_t commodity;
+        entt::entity buyer;
+        entt::entity seller;
+        int quantity;
+        double price;
+    };
+
+    constexpr std::uint32_t trade_journal_version = 1;
+
+    struct trade_journal_error : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    // Every trade the sim settles, kept in a fixed-size ring with a column per field. Appending
+    // never allocates or locks. Without a writer the ring keeps the latest trades, overwriting
+    // the oldest; with one, whole segments are streamed to a file from a background thread,
+    // and trades that arrive while the writer has the ring full are dropped and counted.
+    class trade_journal {
+    public:
+        // trades the writer takes at a time
+        static constexpr std::size_t segment_size = 4096;
+    private:
+        std::size_t capacity_;
+        std::unique_ptr<std::int64_t[]> ticks;
+        std::unique_ptr<entt::entity[]> markets;
+        std::unique_ptr<std::uint32_t[]> commodities;
+        std::unique_ptr<entt::entity[]> buyers;
+        std::unique_ptr<entt::entity[]> sellers;
+        std::unique_ptr<int[]> quantities;
+        std::unique_ptr<double[]> prices;
+
+        // trades appended, only ever written by the appending thread
+        std::atomic<std::uint64_t> head = 0;
+        // trades written out, only ever written by the writer
+        std::atomic<std::uint64_t> tail = 0;
+        std::uint64_t dropped_ = 0;
+
+        std::ofstream file;
+        std::thread writer;
+        std::atomic<bool> stopping = false;
+        void write_segments();
+    public:
+        // capacity is rounded up to whole segments
+        explicit trade_journal(std::size_t capacity = 64 * segment_size);
+        trade_journal(const trade_journal&) = delete;
+        // writes out everything appended before stopping the writer
+        ~trade_journal();
+
+        // start streaming trades to a file, from the oldest still in the ring
+        void write_to(const std::string& filename);
+
+        // only ever called from one thread at a time
+        void append(const trade& the_trade);
+
+        std::size_t capacity() const;
+        std::uint64_t appended() const;
+        std::uint64_t dropped() const;
+        // trades still in the ring, which the appending thread can read, oldest first
+        std::size_t retained() const;
+        trade operator[](std::size_t i) const;
+    };
+
+    // every trade in a journal file, up to the last whole segment if it was cut short
+    std::vector<trade> read_trade_journal(const std::string& filename);
+}
+
+#endif
@@ -20,7 +20,7 @@ namespace std {
     };
     template<>
     struct hash<glm::ivec2> {
-        std::size_t operator()(glm::vec2 xy) const;
+        std::size_t operator()(glm::ivec2 xy) const;
     };
 }
 
@@ -0,0 +1,59 @@
+#ifndef TE_WORK_SCHEDULE_HPP_INCLUDED
+#define TE_WORK_SCHEDULE_HPP_INCLUDED
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <entt/entt.hpp>
+
+namespace te {
+    // Buildings waiting on their next piece of work, soonest first, as a binary heap.
+    // Buildings due at the same time come out in the order they were scheduled.
+    // Entries aren't removed when plans change; whoever runs the schedule checks each one
+    // is still wanted as it comes out.
+    class work_schedule {
+        struct entry {
+            double due;
+            std::uint64_t sequence;
+            entt::entity building;
+        };
+        // orders the heap so the soonest entry is at the front
+        static bool later(const entry& a, const entry& b) {
+            return a.due > b.due || (a.due == b.due && a.sequence > b.sequence);
+        }
+        std::vector<entry> heap;
+        std::uint64_t next_sequence = 0;
+    public:
+        void schedule(entt::entity building, double due) {
+            heap.push_back(entry { due, next_sequence++, building });
+            std::push_heap(heap.begin(), heap.end(), later);
+        }
+        // calls run(building, due) for every entry due by now, soonest first, including any
+        // that run schedules for no later than now
+        template<typename F>
+        void run_due(double now, F&& run) {
+            while (!heap.empty() && heap.front().due <= now) {
+                std::pop_heap(heap.begin(), heap.end(), later);
+                const entry next = heap.back();
+                heap.pop_back();
+                run(next.building, next.due);
+            }
+        }
+        // calls visit(building, due) for every entry, in the order run_due would, without running any
+        template<typename F>
+        void each(F&& visit) const {
+            std::vector<entry> in_order = heap;
+            std::sort(in_order.begin(), in_order.end(), [](const entry& a, const entry& b) { return later(b, a); });
+            for (const auto& next : in_order) visit(next.building, next.due);
+        }
+        std::size_t size() const {
+            return heap.size();
+        }
+        void clear() {
+            heap.clear();
+            next_sequence = 0;
+        }
+    };
+}
+
+#endif
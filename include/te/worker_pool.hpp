@@ -0,0 +1,42 @@
+#ifndef TE_WORKER_POOL_HPP_INCLUDED
+#define TE_WORKER_POOL_HPP_INCLUDED
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+namespace te {
+    // A fixed set of threads that run parallel-for style jobs.
+    class worker_pool {
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable idle;
+        const std::function<void(std::size_t)>* job = nullptr;
+        std::size_t job_count = 0;
+        std::atomic<std::size_t> next_task = 0;
+        std::size_t finished = 0;
+        std::size_t busy = 0;
+        std::uint64_t generation = 0;
+        bool stopping = false;
+
+        void work();
+        void drain(const std::function<void(std::size_t)>& task, std::size_t count);
+    public:
+        explicit worker_pool(std::size_t threads);
+        worker_pool(const worker_pool&) = delete;
+        ~worker_pool();
+
+        // threads including the caller
+        std::size_t size() const;
+        // Calls task(i) for every i in [0, count) across the pool, the calling thread included,
+        // and returns once all of them have finished.
+        void run(std::size_t count, const std::function<void(std::size_t)>& task);
+    };
+}
+
+#endif
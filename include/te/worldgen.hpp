@@ -0,0 +1,60 @@
+#ifndef TE_WORLDGEN_HPP_INCLUDED
+#define TE_WORLDGEN_HPP_INCLUDED
+
+#include <vector>
+#include <optional>
+#include <utility>
+#include <glm/glm.hpp>
+
+namespace te {
+    // what the world generator needs to know about a blueprint
+    struct blueprint_shape {
+        glm::ivec2 dimensions;
+        // relative likelihood of being picked
+        double weight;
+        // radius of influence, for markets
+        std::optional<double> market_radius;
+    };
+
+    struct planned_building {
+        std::size_t blueprint_ix;
+        glm::ivec2 topleft;
+    };
+
+    struct tile_plan {
+        std::vector<planned_building> buildings;
+    };
+
+    // The map cut into square tiles, row by row. Tiles on the right and bottom edges may be smaller.
+    struct world_tiling {
+        glm::ivec2 map_topleft;
+        glm::ivec2 map_dimensions;
+        int tile_size;
+        glm::ivec2 counts;
+
+        world_tiling(glm::ivec2 map_dimensions, int tile_size);
+        std::size_t size() const;
+        // top-left cell and dimensions of a tile
+        std::pair<glm::ivec2, glm::ivec2> tile(std::size_t tile_ix) const;
+        // how many of a total spread in proportion to area land in a tile
+        int share(std::size_t tile_ix, int total) const;
+    };
+
+    // Places up to count buildings in a tile by dart throwing. Each footprint keeps spacing cells
+    // clear of the others, which gives an even, blue-noise spread, and gives up after a bounded
+    // number of darts rather than hunting for the last free cell.
+    // Markets keep their whole radius inside the tile, so buildings in different tiles can never
+    // conflict and every market's members are in its own tile.
+    // Only depends on its arguments, so tiles can be planned in any order or at once.
+    tile_plan plan_tile (
+        const std::vector<blueprint_shape>& shapes,
+        glm::ivec2 topleft,
+        glm::ivec2 dimensions,
+        int count,
+        int spacing,
+        unsigned seed,
+        std::size_t tile_ix
+    );
+}
+
+#endif
@@ -3,7 +3,10 @@
 #include <examples/imgui_impl_glfw.h>
 #include <examples/imgui_impl_opengl3.h>
 #include <spdlog/spdlog.h>
+#include <algorithm>
 #include <chrono>
+#include <map>
+#include <utility>
 #include <te/maths.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -24,8 +27,9 @@ namespace {
     }
 }
 
-te::app::app(te::sim& model, unsigned int seed) :
+te::app::app(te::sim& model, unsigned int seed, te::command_log* log) :
     model { model },
+    log { log },
     rengine { seed },
     win { glfw.make_window(1920 - 200, 1080 - 200, "Hello, World!", false)},
     imgui_io { setup_imgui(win) },
@@ -35,7 +39,7 @@ te::app::app(te::sim& model, unsigned int seed) :
         14.0f,
         static_cast<float>(win.width()) / win.height()
     },
-    terrain_renderer{ win.gl, rengine, model.map_width, model.map_height },
+    terrain_renderer{ win.gl, seed, model.map_width, model.map_height },
     mesh_renderer { win.gl },
     colour_picker{ win },
     loader { win.gl },
@@ -53,10 +57,15 @@ te::app::app(te::sim& model, unsigned int seed) :
     glCullFace(GL_BACK);
 
     marker = model.entities.create();
-    model.entities.assign<render_mesh>(marker, "media/dwelling.glb");
+    model.entities.assign<render_mesh>(marker, te::intern("media/dwelling.glb"));
     model.entities.assign<footprint>(marker, glm::vec2{1.0f, 1.0f});
 }
 
+std::optional<entt::entity> te::app::issue(const te::command& cmd) {
+    if (log) log->record(cmd);
+    return te::apply(model, cmd);
+}
+
 void te::app::on_key(int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_Q && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
         cam.offset = glm::rotate(cam.offset, -glm::half_pi<float>()/4.0f, glm::vec3{0.0f, 0.0f, 1.0f});
@@ -64,33 +73,61 @@ void te::app::on_key(int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_E && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
         cam.offset = glm::rotate(cam.offset, glm::half_pi<float>()/4.0f, glm::vec3{0.0f, 0.0f, 1.0f});
     }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        clock.paused = !clock.paused;
+    }
+    if (key == GLFW_KEY_N && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+        clock.step_once();
+    }
+    if (key == GLFW_KEY_EQUAL && action == GLFW_PRESS) {
+        clock.speed = std::min(clock.speed * 2.0, 64.0);
+    }
+    if (key == GLFW_KEY_MINUS && action == GLFW_PRESS) {
+        clock.speed = std::max(clock.speed / 2.0, 0.25);
+    }
 }
 
 void te::app::on_mouse_button(int button, int action, int mods) {
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+        drag_from = ghost ? std::nullopt : pos_under_mouse;
+    }
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
         if (ghost) {
-            auto proto = model.entities.get<te::ghost>(*ghost).proto;
-            if (model.try_place(proto, model.entities.get<te::site>(*ghost).position)) {
-                model.families[1].balance -= model.entities.get<te::price>(proto).price;
-                model.entities.destroy(*ghost);
+            if (issue(te::place_ghost_command { 1 })) {
                 ghost.reset();
                 return;
             }
         }
+        const auto from = std::exchange(drag_from, std::nullopt);
+        // anything shorter is a click
+        if (from && pos_under_mouse && glm::distance(*from, *pos_under_mouse) > 1.0f) {
+            select_box(*from, *pos_under_mouse);
+            return;
+        }
+        selected.clear();
         if (pos_under_mouse) {
-            auto map_entities = model.entities.view<te::site, te::pickable>();
-            for (auto entity : map_entities) {
-                auto& map_site = map_entities.get<te::site>(entity);
-                if (glm::distance(map_site.position, *pos_under_mouse) <= 1.0f) {
-                    inspected = entity;
-                    return;
-                }
-            }
+            inspected = model.sites.nearest(*pos_under_mouse, 1.0f, [&](entt::entity entity) {
+                return model.entities.has<te::pickable>(entity);
+            });
+            return;
         }
         inspected.reset();
     }
 }
 
+void te::app::select_box(glm::vec2 a, glm::vec2 b) {
+    selected.clear();
+    model.sites.each_in_rect(glm::min(a, b), glm::max(a, b), [&](entt::entity entity, glm::vec2) {
+        if (model.entities.has<te::pickable>(entity)) selected.push_back(entity);
+    });
+    std::sort(selected.begin(), selected.end());
+    if (selected.size() == 1) {
+        inspected = selected.front();
+    } else {
+        inspected.reset();
+    }
+}
+
 glm::mat4 rotate_zup = glm::mat4_cast(te::rotation_between_units (
     glm::vec3 {0.0f, 1.0f, 0.0f},
     glm::vec3 {0.0f, 0.0f, 1.0f}
@@ -108,6 +145,7 @@ void te::app::render_scene() {
     terrain_renderer.render(cam);
 
     auto instances = model.entities.group<render_mesh, site, footprint>();
+    // by interned id rather than by path, which is all batching needs
     instances.sort<te::render_mesh> (
         [](const auto& lhs, const auto& rhs) {
             return lhs.filename < rhs.filename;
@@ -118,19 +156,16 @@ void te::app::render_scene() {
     const auto end = instances.end();
     auto it = begin;
 
-    const te::market* market = nullptr;
-    const te::site* market_site = nullptr;
-    if (inspected) {
-        market = model.entities.try_get<te::market>(*inspected);
-        market_site = model.entities.try_get<te::site>(*inspected);
-    }
+    const bool inspecting_market = inspected && model.entities.has<te::market>(*inspected);
 
     do {
         std::vector<te::mesh_renderer::instance_attributes> instance_attributes;
         const auto& current_rmesh = instances.get<render_mesh>(*it);
         while (it != end && instances.get<render_mesh>(*it).filename == current_rmesh.filename) {
-            bool tinted = market && market_site && model.in_market(instances.get<site>(*it), *market_site, *market)
-                       || inspected == *it;            
+            bool tinted = inspecting_market && model.is_member(*inspected, *it)
+                       || inspected == *it
+                       || ghost == *it && !ghost_placeable
+                       || std::binary_search(selected.begin(), selected.end(), *it);
             instance_attributes.push_back (
                 te::mesh_renderer::instance_attributes {
                     instances.get<site>(*it).position,
@@ -162,36 +197,56 @@ void te::app::render_inspector() {
     ImGui::Begin("Inspector", nullptr, 0);
     ImGui::Text("FPS: %f", fps);
     ImGui::Separator();
+    if (!selected.empty()) {
+        // how many of each kind of thing, as the selection may have thousands in it
+        std::map<std::string, std::size_t> kinds;
+        for (auto entity : selected) {
+            if (!model.entities.valid(entity)) continue;
+            if (auto maybe_named = model.entities.try_get<te::named>(entity); maybe_named) {
+                kinds[te::str(maybe_named->name)]++;
+            }
+        }
+        ImGui::Text(fmt::format("{} selected", selected.size()).c_str());
+        for (const auto& [kind, count] : kinds) {
+            ImGui::Text(fmt::format("{}x {}", count, kind).c_str());
+        }
+        ImGui::Separator();
+    }
     if (inspected) {
         if (auto [maybe_site, maybe_named] = model.entities.try_get<te::site, te::named>(*inspected); maybe_site && maybe_named) {
             ImGui::Text("Map position: (%f, %f)", maybe_site->position.x, maybe_site->position.y);
             auto id_string = fmt::format("{}", *reinterpret_cast<std::uint32_t*>(&*inspected));
-            ImGui::Text("%s", maybe_named->name.c_str());
+            ImGui::Text("%s", te::display_name(*inspected, *maybe_named).c_str());
             ImGui::Separator();
         }
         if (auto the_generator = model.entities.try_get<te::generator>(*inspected); the_generator) {
-            auto& rendr_tex = model.entities.get<te::render_tex>(the_generator->output);
+            const auto output_e = model.commodities[the_generator->output];
+            auto& rendr_tex = model.entities.get<te::render_tex>(output_e);
             ImGui::Image(*resources.lazy_load<te::gl::texture2d>(rendr_tex.filename).hnd, ImVec2{24, 24});
             ImGui::SameLine();
-            const auto& output_commodity_name = model.entities.get<te::named>(the_generator->output);
-            ImGui::Text(fmt::format("{} @ {}/s", output_commodity_name.name, the_generator->rate).c_str());
+            const auto& output_commodity_name = model.entities.get<te::named>(output_e);
+            ImGui::Text(fmt::format("{} @ {}/s", te::str(output_commodity_name.name), the_generator->rate).c_str());
             ImGui::SameLine();
-            ImGui::ProgressBar(the_generator->progress);
+            ImGui::ProgressBar(model.progress(*the_generator));
             ImGui::Separator();
         }
         if (auto demander = model.entities.try_get<te::demander>(*inspected); demander) {
-            for (auto [demanded, rate] : demander->rate) {
-                auto [name, tex] = model.entities.get<te::named, te::render_tex>(demanded);
+            for (std::size_t commodity = 0; commodity < model.commodities.size(); commodity++) {
+                const double rate = demander->rate[commodity];
+                if (rate == 0.0) continue;
+                auto [name, tex] = model.entities.get<te::named, te::render_tex>(model.commodities[commodity]);
                 ImGui::Image(*resources.lazy_load<te::gl::texture2d>(tex.filename).hnd, ImVec2{24, 24});
                 ImGui::SameLine();
-                ImGui::Text(fmt::format("{} @ {}/s", name.name, rate).c_str());
+                ImGui::Text(fmt::format("{} @ {}/s", te::str(name.name), rate).c_str());
             }
             ImGui::Separator();
         }
-        if (auto inventory = model.entities.try_get<te::inventory>(*inspected); inventory && !inventory->stock.empty()) {
-            for (auto [commodity_entity, stock] : inventory->stock) {
-                auto& name = model.entities.get<te::named>(commodity_entity);
-                ImGui::Text(fmt::format("{}x {}", stock, name.name).c_str());
+        if (auto inventory = model.entities.try_get<te::inventory>(*inspected); inventory && inventory->stock != te::per_commodity<int>{}) {
+            for (std::size_t commodity = 0; commodity < model.commodities.size(); commodity++) {
+                const int stock = inventory->stock[commodity];
+                if (stock == 0) continue;
+                auto& name = model.entities.get<te::named>(model.commodities[commodity]);
+                ImGui::Text(fmt::format("{}x {}", stock, te::str(name.name)).c_str());
             }
             ImGui::Separator();
         }
@@ -201,19 +256,25 @@ void te::app::render_inspector() {
         }
         if (auto [producer, inventory] = model.entities.try_get<te::producer, te::inventory>(*inspected); producer && inventory) {
             ImGui::Text("Inputs");
-            for (auto& [commodity_e, needed] : producer->inputs) {
+            for (std::size_t commodity = 0; commodity < model.commodities.size(); commodity++) {
+                const double needed = producer->inputs[commodity];
+                if (needed == 0.0) continue;
+                const auto commodity_e = model.commodities[commodity];
                 auto& commodity_tex = model.entities.get<te::render_tex>(commodity_e);
                 ImGui::Image(*resources.lazy_load<te::gl::texture2d>(commodity_tex.filename).hnd, ImVec2{24, 24});
                 ImGui::SameLine();
-                ImGui::Text(fmt::format("{}: {}/{}", model.entities.get<named>(commodity_e).name, inventory->stock[commodity_e], needed).c_str());
+                ImGui::Text(fmt::format("{}: {}/{}", te::str(model.entities.get<named>(commodity_e).name), inventory->stock[commodity], needed).c_str());
             }
-            ImGui::ProgressBar(producer->progress);
+            ImGui::ProgressBar(model.progress(*producer));
             ImGui::Text(fmt::format("Outputs @{}/s", producer->rate).c_str());
-            for (auto& [commodity_e, produced] : producer->outputs) {
+            for (std::size_t commodity = 0; commodity < model.commodities.size(); commodity++) {
+                const double produced = producer->outputs[commodity];
+                if (produced == 0.0) continue;
+                const auto commodity_e = model.commodities[commodity];
                 auto& commodity_tex = model.entities.get<te::render_tex>(commodity_e);
                 ImGui::Image(*resources.lazy_load<te::gl::texture2d>(commodity_tex.filename).hnd, ImVec2{24, 24});
                 ImGui::SameLine();
-                ImGui::Text(fmt::format("{}: ×{}", model.entities.get<named>(commodity_e).name, produced).c_str());
+                ImGui::Text(fmt::format("{}: ×{}", te::str(model.entities.get<named>(commodity_e).name), produced).c_str());
             }
         }
         if (auto market = model.entities.try_get<te::market>(*inspected); market) {
@@ -248,19 +309,19 @@ void te::app::render_inspector() {
             ImGui::NextColumn();
 
             ImGui::SetColumnWidth(3, width_available);
-            for (auto [commodity_entity, price] : market->prices) {
-                auto [commodity_name, commodity_tex] = model.entities.get<te::named, te::render_tex>(commodity_entity);
-                ImGui::Text(fmt::format("{}", model.market_stock(*inspected, commodity_entity)).c_str());
+            for (std::size_t commodity = 0; commodity < model.commodities.size(); commodity++) {
+                auto [commodity_name, commodity_tex] = model.entities.get<te::named, te::render_tex>(model.commodities[commodity]);
+                ImGui::Text(fmt::format("{}", model.market_stock(*inspected, commodity)).c_str());
                 ImGui::NextColumn();
 
                 ImGui::Image(*resources.lazy_load<te::gl::texture2d>(commodity_tex.filename).hnd, ImVec2{24, 24});
                 ImGui::NextColumn();
 
-                ImGui::Text(commodity_name.name.c_str());
+                ImGui::Text(te::str(commodity_name.name).c_str());
                 ImGui::NextColumn();
 
-                double commodity_demand = market->demand[commodity_entity];
-                double commodity_price = market->prices[commodity_entity];
+                double commodity_demand = market->demand[commodity];
+                double commodity_price = market->prices[commodity];
                 ImDrawList* draw = ImGui::GetWindowDrawList();
                 static const auto light_blue = ImColor(ImVec4{22.9/100.0, 60.7/100.0, 85.9/100.0, 1.0f});
                 static const auto dark_blue = ImColor(ImVec4{22.9/255.0, 60.7/255.0, 85.9/255.0, 1.0f});
@@ -312,17 +373,158 @@ void te::app::render_inspector() {
     ImGui::End();
 }
 
+void te::app::render_profiler() {
+    ImGui::Begin("Sim Profiler", &show_profiler, 0);
+    const auto& history = model.profile;
+    if (history.size() == 0) {
+        ImGui::Text("No ticks yet");
+        ImGui::End();
+        return;
+    }
+    std::vector<float> tick_ms(history.size());
+    te::phase_times mean {};
+    te::phase_times worst {};
+    for (std::size_t i = 0; i < history.size(); i++) {
+        tick_ms[i] = static_cast<float>(history[i].seconds * 1e3);
+        for (std::size_t phase = 0; phase < te::tick_phase_count; phase++) {
+            mean[phase] += history[i].times[phase] / history.size();
+            worst[phase] = std::max(worst[phase], history[i].times[phase]);
+        }
+    }
+    ImGui::PlotLines (
+        "",
+        tick_ms.data(),
+        static_cast<int>(tick_ms.size()),
+        0,
+        fmt::format("last {} ticks, {:.3f} ms", history.size(), tick_ms.back()).c_str(),
+        0.0f,
+        *std::max_element(tick_ms.begin(), tick_ms.end()),
+        ImVec2{-1, 60}
+    );
+    ImGui::Separator();
+
+    // market phases are summed over threads, so can add up to more than the tick took
+    ImGui::Columns(3);
+    ImGui::Text("Phase");
+    ImGui::NextColumn();
+    ImGui::Text("Mean ms");
+    ImGui::NextColumn();
+    ImGui::Text("Worst ms");
+    ImGui::NextColumn();
+    for (std::size_t phase = 0; phase < te::tick_phase_count; phase++) {
+        ImGui::Text(te::phase_name(static_cast<te::tick_phase>(phase)));
+        ImGui::NextColumn();
+        ImGui::Text(fmt::format("{:.3f}", mean[phase] * 1e3).c_str());
+        ImGui::NextColumn();
+        ImGui::Text(fmt::format("{:.3f}", worst[phase] * 1e3).c_str());
+        ImGui::NextColumn();
+    }
+    ImGui::Columns();
+    ImGui::Separator();
+
+    // the slowest markets of the last tick
+    const auto& latest = history.latest();
+    auto market_secs = [](const te::market_profile& market) {
+        double secs = 0.0;
+        for (auto phase_secs : market.times) secs += phase_secs;
+        return secs;
+    };
+    std::vector<const te::market_profile*> slowest;
+    for (const auto& market : latest.markets) {
+        slowest.push_back(&market);
+    }
+    const std::size_t shown = std::min<std::size_t>(slowest.size(), 10);
+    std::partial_sort (
+        slowest.begin(),
+        slowest.begin() + shown,
+        slowest.end(),
+        [&](auto a, auto b) { return market_secs(*a) > market_secs(*b); }
+    );
+    ImGui::Text(fmt::format("Tick {}: {} markets, {} merchants travelling", latest.tick, latest.markets.size(), latest.merchants).c_str());
+    ImGui::Columns(4);
+    ImGui::Text("Market");
+    ImGui::NextColumn();
+    ImGui::Text("Members");
+    ImGui::NextColumn();
+    ImGui::Text("ms");
+    ImGui::NextColumn();
+    ImGui::Text("Slowest phase");
+    ImGui::NextColumn();
+    for (std::size_t i = 0; i < shown; i++) {
+        const auto& market = *slowest[i];
+        // the market may have been demolished since
+        if (auto name = model.entities.valid(market.market) ? model.entities.try_get<te::named>(market.market) : nullptr; name) {
+            ImGui::Text(te::display_name(market.market, *name).c_str());
+        } else {
+            ImGui::Text(fmt::format("{}", static_cast<std::uint32_t>(market.market)).c_str());
+        }
+        ImGui::NextColumn();
+        ImGui::Text(fmt::format("{}", market.members).c_str());
+        ImGui::NextColumn();
+        ImGui::Text(fmt::format("{:.3f}", market_secs(market) * 1e3).c_str());
+        ImGui::NextColumn();
+        const auto slowest_phase = std::max_element(market.times.begin(), market.times.end()) - market.times.begin();
+        ImGui::Text(te::phase_name(static_cast<te::tick_phase>(slowest_phase)));
+        ImGui::NextColumn();
+    }
+    ImGui::Columns();
+    ImGui::End();
+}
+
 void te::app::render_controller() {
     ImGui::Begin("Controller", nullptr, 0);
     ImGui::Text(fmt::format("¤{}", model.families[1].balance).c_str());
+    ImGui::Checkbox("Paused", &clock.paused);
+    ImGui::SameLine();
+    if (ImGui::Button("Step")) {
+        clock.step_once();
+    }
+    ImGui::SameLine();
+    ImGui::Text(fmt::format("×{} ({} dropped)", clock.speed, clock.dropped()).c_str());
+    ImGui::SameLine();
+    ImGui::Checkbox("Profiler", &show_profiler);
+    ImGui::Checkbox("Sim LOD", &lod_enabled);
+    if (lod_enabled) {
+        ImGui::SameLine();
+        if (ImGui::InputInt("stride", &lod_stride)) {
+            lod_stride = std::clamp(lod_stride, 1, 64);
+        }
+        const auto& work = model.lod_work;
+        if (const long total = work.ticked + work.deferred; total > 0) {
+            ImGui::SameLine();
+            ImGui::Text(fmt::format("{:.0f}% of market ticks put off", 100.0 * work.deferred / total).c_str());
+        }
+    }
+    if (fast_forward_left > 0.0) {
+        const double done = fast_forward_for - fast_forward_left;
+        ImGui::ProgressBar(done / fast_forward_for, ImVec2{-1, 0}, fmt::format("{:.0f}/{:.0f}s", done, fast_forward_for).c_str());
+        if (fast_forward_progress) {
+            ImGui::Text(fmt::format (
+                "{:.0f} ticks/s, step {}s",
+                fast_forward_progress->ticks / fast_forward_progress->real_seconds,
+                fast_forward_progress->step
+            ).c_str());
+        }
+        if (ImGui::Button("Stop")) {
+            fast_forward_left = 0.0;
+        }
+    } else {
+        ImGui::InputDouble("game seconds", &fast_forward_for);
+        ImGui::SameLine();
+        if (ImGui::Button("Fast-forward") && fast_forward_for > 0.0) {
+            fast_forward_left = fast_forward_for;
+            fast_forward_slice = clock.step() * 16.0;
+            fast_forward_progress.reset();
+        }
+    }
     if (ImGui::BeginTabBar("MainTabbar")) {
         if (ImGui::BeginTabItem("Build")) {
-            for (auto blueprint : model.blueprints) {
+            for (std::size_t blueprint_ix = 0; blueprint_ix < model.blueprints.size(); blueprint_ix++) {
+                const auto blueprint = model.blueprints[blueprint_ix];
                 if (auto [named, price, footprint] = model.entities.try_get<te::named, te::price, te::footprint>(blueprint); named && price && footprint) {
-                    if (ImGui::Button(fmt::format("{}: ¤{}", named->name, price->price).c_str())) {
+                    if (ImGui::Button(fmt::format("{}: ¤{}", te::str(named->name), price->price).c_str())) {
                         if (!ghost) {
-                            ghost = model.entities.create<te::site, te::footprint, te::render_mesh>(blueprint, model.entities);
-                            model.entities.assign<te::ghost>(*ghost, blueprint);
+                            ghost = issue(te::pick_up_command { static_cast<std::uint32_t>(blueprint_ix) });
                         }
                     }
                 }
@@ -337,26 +539,24 @@ void te::app::render_controller() {
                 const auto& merchant = merchants.get<te::merchant>(merchant_entity);
                 const auto& merchant_inventory = merchants.get<te::inventory>(merchant_entity);
                 const auto& merchant_name = merchants.get<te::named>(merchant_entity);
-                ImGui::Text(fmt::format("{}: ¤{}", merchant_name.name, trader.balance).c_str());
+                ImGui::Text(fmt::format("{}: ¤{}", te::display_name(merchant_entity, merchant_name), trader.balance).c_str());
                 if (merchant.route) {
                     ImGui::Text(merchant.route->name.c_str());
                     auto next_stop = merchant.route->stops[(merchant.last_stop + 1) % merchant.route->stops.size()];
                     auto next_stop_name = model.entities.get<te::named>(next_stop.where);
                     if (merchant.trading) {
-                        ImGui::Text(fmt::format("Trading at {}", next_stop_name.name).c_str());
+                        ImGui::Text(fmt::format("Trading at {}", te::display_name(next_stop.where, next_stop_name)).c_str());
                     } else {
-                        ImGui::Text(fmt::format("En route to {}", next_stop_name.name).c_str());
+                        ImGui::Text(fmt::format("En route to {}", te::display_name(next_stop.where, next_stop_name)).c_str());
                     }
                     ImGui::NewLine();
-                    for (auto commodity : model.commodities) {
-                        const auto stock_it = merchant_inventory.stock.find(commodity);
-                        const int stock = stock_it == merchant_inventory.stock.end() ? 0 : stock_it->second;
-                        const auto leave_with_it = next_stop.leave_with.find(commodity);
-                        const int leave_with = leave_with_it == next_stop.leave_with.end() ? 0 : leave_with_it->second;
+                    for (std::size_t commodity = 0; commodity < model.commodities.size(); commodity++) {
+                        const int stock = merchant_inventory.stock[commodity];
+                        const int leave_with = next_stop.leave_with[commodity];
                         const int buy = std::max(0, leave_with - stock);
                         const int sell = merchant.trading ? std::max(0, stock - leave_with) : 0;
                         const int keep = stock - sell;
-                        const auto& commodity_tex = resources.lazy_load<te::gl::texture2d>(model.entities.get<te::render_tex>(commodity).filename);
+                        const auto& commodity_tex = resources.lazy_load<te::gl::texture2d>(model.entities.get<te::render_tex>(model.commodities[commodity]).filename);
                         for (int i = 0; i < buy; i++) {
                             ImGui::SameLine();
                             ImGui::Image (
@@ -375,8 +575,9 @@ void te::app::render_controller() {
                     }
                 } else {
                     ImGui::Text("No route assigned");
-                    for (auto [commodity, stock] : merchant_inventory.stock) {
-                        const auto& commodity_tex = resources.lazy_load<te::gl::texture2d>(model.entities.get<te::render_tex>(commodity).filename);
+                    for (std::size_t commodity = 0; commodity < model.commodities.size(); commodity++) {
+                        const int stock = merchant_inventory.stock[commodity];
+                        const auto& commodity_tex = resources.lazy_load<te::gl::texture2d>(model.entities.get<te::render_tex>(model.commodities[commodity]).filename);
                         for (int i = 0; i < stock; i++) {
                             ImGui::SameLine();
                             ImGui::Image(*commodity_tex.hnd, ImVec2{24, 24}, ImVec2{0, 0}, ImVec2{1, 1}, ImVec4{1, 1, 1, 1}, ImVec4{1, 1, 1, 1});
@@ -420,10 +621,11 @@ void te::app::render_controller() {
                     ImGui::EndCombo();
                 }
             } else {
-                if (ImGui::BeginCombo("###next_stop_selector", model.entities.get<te::named>(*(selected_next_stop_it.value_or(market_it))).name.c_str())) {
+                const auto selected_market = *(selected_next_stop_it.value_or(market_it));
+                if (ImGui::BeginCombo("###next_stop_selector", te::display_name(selected_market, model.entities.get<te::named>(selected_market)).c_str())) {
                     for (;market_it != markets.end(); market_it++) {
                         bool current_next_stop_selected = market_it == selected_next_stop_it;
-                        auto name = model.entities.get<te::named>(*market_it).name;
+                        auto name = te::display_name(*market_it, model.entities.get<te::named>(*market_it));
                         if (ImGui::Selectable(name.c_str(), current_next_stop_selected)) {
                             selected_next_stop_it = market_it;
                         }
@@ -450,11 +652,35 @@ void te::app::render_ui() {
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
     //render_inspector();
+    if (show_profiler) {
+        render_profiler();
+    }
     render_controller();
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+void te::app::fast_forward() {
+    te::advance_options options;
+    // ticks stretch to a few seconds while the economy is settled
+    options.max_step = clock.step() * 16.0;
+    options.on_tick = [&](double dt) {
+        if (log) log->record(te::tick_command { dt });
+    };
+    options.report = [&](const te::advance_report& report) {
+        fast_forward_progress = report;
+    };
+    const double slice = std::min(fast_forward_slice, fast_forward_left);
+    model.advance(slice, clock.step(), options);
+    fast_forward_left -= slice;
+    // aim for slices that keep the window responding, at a few frames a second at least
+    if (fast_forward_progress && fast_forward_progress->real_seconds < 1.0 / 30.0) {
+        fast_forward_slice *= 2.0;
+    } else if (fast_forward_progress && fast_forward_progress->real_seconds > 1.0 / 10.0) {
+        fast_forward_slice = std::max(fast_forward_slice / 2.0, clock.step());
+    }
+}
+
 void te::app::input() {
     if (win.key(GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         win.close();
@@ -463,7 +689,12 @@ void te::app::input() {
 
     mouse_pick();
     if (ghost && pos_under_mouse) {
-        model.entities.assign_or_replace<site>(*ghost, model.snap(*pos_under_mouse, glm::vec2{1.0f, 1.0f}));
+        const auto where = model.snap(*pos_under_mouse, glm::vec2{1.0f, 1.0f});
+        // only moves to a new cell are worth recording
+        if (auto ghost_site = model.entities.try_get<te::site>(*ghost); !ghost_site || ghost_site->position != where) {
+            issue(te::move_ghost_command { where });
+        }
+        ghost_placeable = model.can_place(model.entities.get<te::ghost>(*ghost).proto, where);
     }
 
     glm::vec3 forward = -cam.offset;
@@ -479,6 +710,32 @@ void te::app::input() {
     cam.use_ortho = win.key(GLFW_KEY_SPACE) != GLFW_PRESS;
 }
 
+void te::app::follow_focus() {
+    te::lod_policy policy;
+    // snapped, so that panning the camera doesn't log a command every frame
+    policy.focus = glm::round(glm::vec2{cam.focus.x, cam.focus.y} / 8.0f) * 8.0f;
+    policy.radius = lod_radius;
+    // the market of what's inspected rather than where it stands, so that inspecting a merchant
+    // doesn't log a command every frame as it walks
+    if (inspected && model.entities.valid(*inspected)) {
+        std::optional<entt::entity> market_e;
+        if (model.entities.has<te::market>(*inspected)) {
+            market_e = *inspected;
+        } else if (auto joined = model.influencee_markets.find(*inspected); joined != model.influencee_markets.end() && !joined->second.empty()) {
+            market_e = joined->second.front();
+        }
+        if (market_e) {
+            if (auto market_site = model.entities.try_get<te::site>(*market_e); market_site) {
+                policy.inspected = market_site->position;
+            }
+        }
+    }
+    policy.stride = lod_enabled ? static_cast<std::uint32_t>(lod_stride) : 1;
+    if (policy != model.lod) {
+        issue(te::focus_command { policy });
+    }
+}
+
 void te::app::draw() {
     render_scene();
     render_ui();
@@ -486,16 +743,27 @@ void te::app::draw() {
 
 void te::app::run() {
     auto then = std::chrono::high_resolution_clock::now();
+    auto last_frame = then;
     int frames = 0;
     while (!glfwWindowShouldClose(win.hnd.get())) {
         input();
+        follow_focus();
+        auto now = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> frame_secs = now - last_frame;
+        last_frame = now;
+        if (fast_forward_left > 0.0) {
+            fast_forward();
+        } else {
+            const int steps = clock.advance(frame_secs.count());
+            for (int i = 0; i < steps; i++) {
+                issue(te::tick_command { clock.step() });
+            }
+        }
         if (frames == 5) {
-            auto now = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> secs = now - then;
             fps = static_cast<double>(frames) / secs.count();
-            model.tick(secs.count() * 3.0);
             frames = 0;
-            then = std::chrono::high_resolution_clock::now();
+            then = now;
         }
         draw();
         glfwSwapBuffers(win.hnd.get());
@@ -0,0 +1,278 @@
+#include <te/command_log.hpp>
+#include <te/render_components.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+namespace {
+    constexpr char log_magic[8] = {'t', 'e', 'l', 'o', 'g', '\0', '\0', '\0'};
+    // longest run of ticks held back before it is written, which bounds what a crash loses
+    constexpr std::uint32_t max_tick_run = 1024;
+
+    struct header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t seed;
+        std::int32_t map_width;
+        std::int32_t map_height;
+        std::int32_t buildings;
+        std::int32_t tile_size;
+        std::int32_t spacing;
+    };
+
+    // records are a kind followed by the command's fields, unpadded
+    enum class record_kind : std::uint8_t {
+        tick = 1,
+        pick_up,
+        move_ghost,
+        place_ghost,
+        focus
+    };
+
+    template<typename T>
+    void put(std::ofstream& file, const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    class reader {
+        const std::vector<char>& bytes;
+        std::size_t at = 0;
+    public:
+        explicit reader(const std::vector<char>& bytes) : bytes { bytes } {
+        }
+        bool done() const {
+            return at == bytes.size();
+        }
+        // false, without moving, if there isn't a whole value left
+        template<typename T>
+        bool get(T& value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            if (bytes.size() - at < sizeof(T)) return false;
+            std::memcpy(&value, bytes.data() + at, sizeof(T));
+            at += sizeof(T);
+            return true;
+        }
+    };
+
+    // a point that may not be there, written as whether it is and then its coordinates
+    void put_point(std::ofstream& file, const std::optional<glm::vec2>& point) {
+        put<std::uint8_t>(file, point.has_value());
+        const glm::vec2 coordinates = point.value_or(glm::vec2{0.0f, 0.0f});
+        put(file, coordinates.x);
+        put(file, coordinates.y);
+    }
+
+    bool get_point(reader& in, std::optional<glm::vec2>& point) {
+        std::uint8_t present;
+        glm::vec2 coordinates;
+        if (!in.get(present) || !in.get(coordinates.x) || !in.get(coordinates.y)) return false;
+        point = present ? std::optional<glm::vec2> { coordinates } : std::nullopt;
+        return true;
+    }
+
+    std::optional<te::command> read_record(reader& in, record_kind kind) {
+        switch (kind) {
+        case record_kind::tick: {
+            te::tick_command ticks;
+            if (!in.get(ticks.dt) || !in.get(ticks.count)) return std::nullopt;
+            return ticks;
+        }
+        case record_kind::pick_up: {
+            te::pick_up_command pick_up;
+            if (!in.get(pick_up.blueprint_ix)) return std::nullopt;
+            return pick_up;
+        }
+        case record_kind::move_ghost: {
+            te::move_ghost_command move;
+            if (!in.get(move.where.x) || !in.get(move.where.y)) return std::nullopt;
+            return move;
+        }
+        case record_kind::place_ghost: {
+            te::place_ghost_command place;
+            if (!in.get(place.family_ix)) return std::nullopt;
+            return place;
+        }
+        case record_kind::focus: {
+            te::focus_command focus;
+            auto& policy = focus.policy;
+            if (!get_point(in, policy.focus) || !in.get(policy.radius) || !get_point(in, policy.inspected) || !in.get(policy.stride)) {
+                return std::nullopt;
+            }
+            return focus;
+        }
+        }
+        throw te::command_log_error(fmt::format("Command log is corrupt: unknown record {}", static_cast<int>(kind)));
+    }
+}
+
+std::optional<entt::entity> te::held_ghost(sim& model) {
+    auto ghosts = model.entities.view<ghost>();
+    if (ghosts.empty()) return std::nullopt;
+    return *ghosts.begin();
+}
+
+std::optional<entt::entity> te::apply(sim& model, const command& cmd) {
+    return std::visit (
+        [&](const auto& the_command) -> std::optional<entt::entity> {
+            using command_type = std::decay_t<decltype(the_command)>;
+            if constexpr (std::is_same_v<command_type, tick_command>) {
+                for (std::uint32_t i = 0; i < the_command.count; i++) {
+                    model.tick(the_command.dt);
+                }
+                return std::nullopt;
+            } else if constexpr (std::is_same_v<command_type, pick_up_command>) {
+                if (held_ghost(model) || the_command.blueprint_ix >= model.blueprints.size()) return std::nullopt;
+                const auto blueprint = model.blueprints[the_command.blueprint_ix];
+                // only what's for sale can be picked up
+                if (!model.entities.has<price, footprint>(blueprint)) return std::nullopt;
+                const auto the_ghost = model.entities.create<site, footprint, render_mesh>(blueprint, model.entities);
+                model.entities.assign<ghost>(the_ghost, blueprint);
+                return the_ghost;
+            } else if constexpr (std::is_same_v<command_type, move_ghost_command>) {
+                if (auto the_ghost = held_ghost(model); the_ghost) {
+                    model.entities.assign_or_replace<site>(*the_ghost, the_command.where);
+                }
+                return std::nullopt;
+            } else if constexpr (std::is_same_v<command_type, focus_command>) {
+                model.lod = the_command.policy;
+                return std::nullopt;
+            } else {
+                const auto the_ghost = held_ghost(model);
+                if (!the_ghost || !model.entities.has<site>(*the_ghost) || the_command.family_ix >= model.families.size()) {
+                    return std::nullopt;
+                }
+                const auto proto = model.entities.get<ghost>(*the_ghost).proto;
+                auto placed = model.try_place(proto, model.entities.get<site>(*the_ghost).position);
+                if (placed) {
+                    model.families[the_command.family_ix].balance -= model.entities.get<price>(proto).price;
+                    model.entities.destroy(*the_ghost);
+                }
+                return placed;
+            }
+        },
+        cmd
+    );
+}
+
+long te::recorded_session::ticks() const {
+    long total = 0;
+    for (const auto& cmd : commands) {
+        if (auto ticks = std::get_if<tick_command>(&cmd); ticks) total += ticks->count;
+    }
+    return total;
+}
+
+te::command_log::command_log(const std::string& filename, unsigned seed, const world_params& params) :
+    file { filename, std::ios::binary | std::ios::trunc }
+{
+    if (!file) {
+        throw command_log_error(fmt::format("Couldn't open {} for writing", filename));
+    }
+    header head {};
+    std::memcpy(head.magic, log_magic, sizeof(log_magic));
+    head.version = command_log_version;
+    head.seed = seed;
+    head.map_width = params.map_width;
+    head.map_height = params.map_height;
+    head.buildings = params.buildings;
+    head.tile_size = params.tile_size;
+    head.spacing = params.spacing;
+    put(file, head);
+    file.flush();
+}
+
+te::command_log::~command_log() {
+    flush();
+}
+
+void te::command_log::write(const command& cmd) {
+    std::visit (
+        [&](const auto& the_command) {
+            using command_type = std::decay_t<decltype(the_command)>;
+            if constexpr (std::is_same_v<command_type, tick_command>) {
+                put(file, record_kind::tick);
+                put(file, the_command.dt);
+                put(file, the_command.count);
+            } else if constexpr (std::is_same_v<command_type, pick_up_command>) {
+                put(file, record_kind::pick_up);
+                put(file, the_command.blueprint_ix);
+            } else if constexpr (std::is_same_v<command_type, move_ghost_command>) {
+                put(file, record_kind::move_ghost);
+                put(file, the_command.where.x);
+                put(file, the_command.where.y);
+            } else if constexpr (std::is_same_v<command_type, place_ghost_command>) {
+                put(file, record_kind::place_ghost);
+                put(file, the_command.family_ix);
+            } else {
+                put(file, record_kind::focus);
+                put_point(file, the_command.policy.focus);
+                put(file, the_command.policy.radius);
+                put_point(file, the_command.policy.inspected);
+                put(file, the_command.policy.stride);
+            }
+        },
+        cmd
+    );
+}
+
+void te::command_log::record(const command& cmd) {
+    if (auto ticks = std::get_if<tick_command>(&cmd); ticks) {
+        if (pending_ticks && pending_ticks->dt == ticks->dt && pending_ticks->count + ticks->count <= max_tick_run) {
+            pending_ticks->count += ticks->count;
+            return;
+        }
+        flush();
+        pending_ticks = *ticks;
+        return;
+    }
+    flush();
+    write(cmd);
+    file.flush();
+}
+
+void te::command_log::flush() {
+    if (pending_ticks) {
+        write(*pending_ticks);
+        pending_ticks.reset();
+    }
+    file.flush();
+}
+
+te::recorded_session te::read_command_log(const std::string& filename) {
+    std::ifstream file { filename, std::ios::binary };
+    if (!file) {
+        throw command_log_error(fmt::format("Couldn't open {}", filename));
+    }
+    const std::vector<char> bytes { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    reader in { bytes };
+
+    header head;
+    if (!in.get(head) || std::memcmp(head.magic, log_magic, sizeof(log_magic)) != 0) {
+        throw command_log_error(fmt::format("{} isn't a command log", filename));
+    }
+    if (head.version != command_log_version) {
+        throw command_log_error(fmt::format("{} is command log version {}, expected {}", filename, head.version, command_log_version));
+    }
+    recorded_session session;
+    session.seed = head.seed;
+    session.params.map_width = head.map_width;
+    session.params.map_height = head.map_height;
+    session.params.buildings = head.buildings;
+    session.params.tile_size = head.tile_size;
+    session.params.spacing = head.spacing;
+
+    while (!in.done()) {
+        record_kind kind;
+        in.get(kind);
+        auto cmd = read_record(in, kind);
+        if (!cmd) {
+            spdlog::warn("{} ends part way through a record, ignoring it", filename);
+            break;
+        }
+        session.commands.push_back(*cmd);
+    }
+    return session;
+}
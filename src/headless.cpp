@@ -0,0 +1,369 @@
+#include <te/sim.hpp>
+#include <te/snapshot.hpp>
+#include <te/replay.hpp>
+#include <te/state_hash.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace {
+    void usage(const char* argv0) {
+        fmt::print (
+            "usage: {} [options]\n"
+            "  --seed N         world seed (default 1)\n"
+            "  --width N        map width in cells (default 40)\n"
+            "  --height N       map height in cells (default 40)\n"
+            "  --buildings N    buildings placed at generation (default 100)\n"
+            "  --tile-size N    generation tile size in cells (default 64)\n"
+            "  --spacing N      cells kept clear around generated buildings (default 1)\n"
+            "  --ticks N        ticks to run (default 1000)\n"
+            "  --dt SECONDS     game seconds per tick (default 0.25)\n"
+            "  --threads N      generation and market threads (default: one per core)\n"
+            "  --load FILE      start from a snapshot instead of generating a map\n"
+            "  --save FILE      write a snapshot after ticking\n"
+            "  --record FILE    log the session's commands for replay\n"
+            "  --replay FILE    re-run a logged session instead of generating a map\n"
+            "  --until TICK     stop a replay after this tick (default: the end)\n"
+            "  --keyframes DIR  keep replay keyframes in this directory\n"
+            "  --keyframe-interval N\n"
+            "                   ticks between replay keyframes (default 1000)\n"
+            "  --check-seek     replay again from the start without keyframes and check that\n"
+            "                   it ends in the same state as the replay that used them\n"
+            "  --fast-forward SECONDS\n"
+            "                   run for this many game seconds instead of a number of ticks\n"
+            "  --max-step SECONDS\n"
+            "                   let fast-forward lengthen ticks up to this while prices are settled\n"
+            "  --report SECONDS report fast-forward progress every so many game seconds\n"
+            "  --metrics FILE   write economy metrics as CSV with each report\n"
+            "  --profile FILE   write per-tick, per-market phase timings of the last ticks,\n"
+            "                   as JSON if FILE ends in .json and CSV otherwise\n"
+            "  --profile-ticks N\n"
+            "                   ticks of timings kept for --profile (default 600)\n"
+            "  --trades FILE    journal every trade to FILE\n"
+            "  --lod STRIDE     tick markets out of focus once every STRIDE ticks (default 1)\n"
+            "  --lod-focus X,Y  keep markets near this point at full detail\n"
+            "  --lod-radius N   how far from the focus markets stay at full detail (default 64)\n"
+            "  --hash           print a hash of the sim's state after ticking, for comparing runs\n",
+            argv0
+        );
+    }
+
+    void write_metrics_header(std::ofstream& out, te::sim& model) {
+        out << "time,ticks,markets,population,mean_growth_rate";
+        for (auto commodity_e : model.commodities) {
+            out << ",price_" << te::str(model.entities.get<te::named>(commodity_e).name);
+        }
+        for (std::size_t family_ix = 0; family_ix < model.families.size(); family_ix++) {
+            out << ",family_" << family_ix;
+        }
+        out << '\n';
+    }
+
+    void write_metrics_row(std::ofstream& out, const te::economy_metrics& metrics) {
+        out << fmt::format("{},{},{},{},{}", metrics.time, metrics.ticks, metrics.markets, metrics.population, metrics.mean_growth_rate);
+        for (std::size_t commodity = 0; commodity < metrics.commodities; commodity++) {
+            out << fmt::format(",{}", metrics.mean_prices[commodity]);
+        }
+        for (auto balance : metrics.family_balances) {
+            out << fmt::format(",{}", balance);
+        }
+        // flushed so it can be watched as it's written
+        out << std::endl;
+    }
+}
+
+int main(const int argc, const char** argv) {
+    unsigned seed = 1;
+    te::world_params params;
+    long ticks = 1000;
+    double dt = 0.25;
+    params.threads = std::thread::hardware_concurrency();
+    std::string load_from;
+    std::string save_to;
+    std::string record_to;
+    std::string replay_from;
+    std::optional<long> until;
+    std::string keyframe_dir;
+    long keyframe_interval = 1000;
+    std::optional<double> fast_forward;
+    te::advance_options advancing;
+    std::string metrics_to;
+    std::string profile_to;
+    std::optional<std::size_t> profile_ticks;
+    std::string trades_to;
+    std::optional<te::lod_policy> lod;
+    bool print_hash = false;
+    bool check_seek = false;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (arg == "--hash") {
+            print_hash = true;
+            continue;
+        }
+        if (arg == "--check-seek") {
+            check_seek = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            spdlog::error("{} needs a value", arg);
+            usage(argv[0]);
+            return 1;
+        }
+        const std::string value = argv[++i];
+        try {
+            if (arg == "--seed") seed = std::stoul(value);
+            else if (arg == "--width") params.map_width = std::stoi(value);
+            else if (arg == "--height") params.map_height = std::stoi(value);
+            else if (arg == "--buildings") params.buildings = std::stoi(value);
+            else if (arg == "--tile-size") params.tile_size = std::stoi(value);
+            else if (arg == "--spacing") params.spacing = std::stoi(value);
+            else if (arg == "--ticks") ticks = std::stol(value);
+            else if (arg == "--dt") dt = std::stod(value);
+            else if (arg == "--threads") params.threads = std::stoul(value);
+            else if (arg == "--load") load_from = value;
+            else if (arg == "--save") save_to = value;
+            else if (arg == "--record") record_to = value;
+            else if (arg == "--replay") replay_from = value;
+            else if (arg == "--until") until = std::stol(value);
+            else if (arg == "--keyframes") keyframe_dir = value;
+            else if (arg == "--keyframe-interval") keyframe_interval = std::stol(value);
+            else if (arg == "--fast-forward") fast_forward = std::stod(value);
+            else if (arg == "--max-step") advancing.max_step = std::stod(value);
+            else if (arg == "--report") advancing.report_interval = std::stod(value);
+            else if (arg == "--metrics") metrics_to = value;
+            else if (arg == "--profile") profile_to = value;
+            else if (arg == "--profile-ticks") profile_ticks = std::stoul(value);
+            else if (arg == "--trades") trades_to = value;
+            else if (arg == "--lod") {
+                if (!lod) lod.emplace();
+                lod->stride = static_cast<std::uint32_t>(std::max(std::stoul(value), 1ul));
+            }
+            else if (arg == "--lod-focus") {
+                const auto comma = value.find(',');
+                if (comma == std::string::npos) throw std::invalid_argument { value };
+                if (!lod) lod.emplace();
+                lod->focus = glm::vec2 { std::stof(value.substr(0, comma)), std::stof(value.substr(comma + 1)) };
+            }
+            else if (arg == "--lod-radius") {
+                if (!lod) lod.emplace();
+                lod->radius = std::stof(value);
+            }
+            else {
+                spdlog::error("Unknown option {}", arg);
+                usage(argv[0]);
+                return 1;
+            }
+        } catch (const std::exception&) {
+            spdlog::error("Bad value \"{}\" for {}", value, arg);
+            return 1;
+        }
+    }
+
+    if (!record_to.empty() && (!load_from.empty() || !replay_from.empty())) {
+        spdlog::error("Only sessions on a generated map can be recorded");
+        return 1;
+    }
+    if (check_seek && replay_from.empty()) {
+        spdlog::error("--check-seek needs --replay");
+        return 1;
+    }
+
+    auto then = std::chrono::steady_clock::now();
+    std::unique_ptr<te::sim> loaded;
+    std::unique_ptr<te::replay> replaying;
+    try {
+        if (!replay_from.empty()) {
+            replaying = std::make_unique<te::replay> (
+                te::read_command_log(replay_from),
+                keyframe_dir,
+                keyframe_dir.empty() ? 0 : keyframe_interval,
+                params.threads
+            );
+        } else if (!load_from.empty()) {
+            loaded = te::load_snapshot(load_from, params.threads);
+        } else {
+            loaded = std::make_unique<te::sim>(seed, params);
+        }
+    } catch (const std::runtime_error& e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+    // a replay may swap in a keyframe as it goes, so always go through it for the sim
+    auto model = [&]() -> te::sim& { return replaying ? replaying->model() : *loaded; };
+    std::chrono::duration<double> generation_secs = std::chrono::steady_clock::now() - then;
+    if (replaying) {
+        const auto& session = replaying->recorded();
+        fmt::print (
+            "seed {}, {}x{} map, {} buildings, {} entities, generated in {:.3f}s to replay {} commands over {} ticks from {}\n",
+            session.seed, session.params.map_width, session.params.map_height, session.params.buildings,
+            model().entities.alive(), generation_secs.count(), session.commands.size(), session.ticks(), replay_from
+        );
+    } else if (!load_from.empty()) {
+        fmt::print (
+            "seed {}, {}x{} map, {} entities at tick {}, loaded from {} in {:.3f}s\n",
+            model().seed, model().map_width, model().map_height, model().entities.alive(), model().ticks, load_from, generation_secs.count()
+        );
+    } else {
+        fmt::print (
+            "seed {}, {}x{} map, {} buildings, {} entities, generated in {:.3f}s\n",
+            seed, model().map_width, model().map_height, params.buildings, model().entities.alive(), generation_secs.count()
+        );
+    }
+    fmt::print("{} occupancy chunks allocated\n", model().grid.allocated_chunks());
+    if (profile_ticks) {
+        model().profile.set_capacity(*profile_ticks);
+    }
+    if (!trades_to.empty()) {
+        try {
+            model().journal = std::make_unique<te::trade_journal>();
+            model().journal->write_to(trades_to);
+        } catch (const te::trade_journal_error& e) {
+            spdlog::error("{}", e.what());
+            return 1;
+        }
+    }
+    if (replaying) {
+        // a seek may load a keyframe, which mustn't lose what was just set up
+        replaying->on_swap = [](te::sim& old_model, te::sim& new_model) {
+            new_model.profile.set_capacity(old_model.profile.capacity());
+            new_model.journal = std::move(old_model.journal);
+        };
+    }
+
+    then = std::chrono::steady_clock::now();
+    try {
+        if (replaying) {
+            const long first_tick = replaying->tick();
+            replaying->seek(until.value_or(replaying->recorded().ticks()));
+            ticks = replaying->tick() - first_tick;
+        } else {
+            std::unique_ptr<te::command_log> log;
+            if (!record_to.empty()) {
+                log = std::make_unique<te::command_log>(record_to, seed, params);
+            }
+            if (lod && *lod != model().lod) {
+                const te::command focus = te::focus_command { *lod };
+                if (log) log->record(focus);
+                te::apply(model(), focus);
+            }
+            if (fast_forward) {
+                std::ofstream metrics;
+                if (!metrics_to.empty()) {
+                    metrics.open(metrics_to);
+                    if (!metrics) throw std::runtime_error(fmt::format("Couldn't open {} for writing", metrics_to));
+                    write_metrics_header(metrics, model());
+                }
+                if (log) {
+                    advancing.on_tick = [&](double tick_dt) { log->record(te::tick_command { tick_dt }); };
+                }
+                advancing.report = [&](const te::advance_report& report) {
+                    fmt::print (
+                        "  {:.0f}/{:.0f} game seconds, {} ticks, step {}s, {:.1f} ticks/s\n",
+                        report.elapsed, report.game_seconds, report.ticks, report.step, report.ticks / report.real_seconds
+                    );
+                    if (metrics.is_open()) write_metrics_row(metrics, model().measure());
+                };
+                ticks = model().advance(*fast_forward, dt, advancing);
+            } else {
+                const te::command tick = te::tick_command { dt };
+                for (long i = 0; i < ticks; i++) {
+                    if (log) log->record(tick);
+                    te::apply(model(), tick);
+                }
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - then;
+
+    if (replaying) {
+        fmt::print (
+            "replayed {} ticks on {} threads in {:.3f}s: {:.1f} ticks/s\n",
+            ticks, params.threads, secs.count(), ticks / secs.count()
+        );
+    } else if (fast_forward) {
+        fmt::print (
+            "{} ticks over {} game seconds on {} threads in {:.3f}s: {:.1f} ticks/s\n",
+            ticks, *fast_forward, params.threads, secs.count(), ticks / secs.count()
+        );
+    } else {
+        fmt::print (
+            "{} ticks of {}s on {} threads in {:.3f}s: {:.1f} ticks/s\n",
+            ticks, dt, params.threads, secs.count(), ticks / secs.count()
+        );
+    }
+    // market phases are summed over markets, and over threads when ticking in parallel
+    for (std::size_t phase = 0; phase < te::tick_phase_count; phase++) {
+        const double phase_secs = model().tick_times[phase];
+        fmt::print (
+            "  {:<12} {:10.3f} ms {:10.3f} us/tick\n",
+            te::phase_name(static_cast<te::tick_phase>(phase)),
+            phase_secs * 1e3,
+            phase_secs * 1e6 / std::max(ticks, 1l)
+        );
+    }
+    if (const auto& work = model().lod_work; work.deferred > 0) {
+        fmt::print (
+            "LOD put off {} of {} market ticks ({:.1f}%)\n",
+            work.deferred, work.ticked + work.deferred, 100.0 * work.deferred / (work.ticked + work.deferred)
+        );
+    }
+    if (print_hash) {
+        fmt::print("state hash {:016x} at tick {}\n", te::state_hash(model()), model().ticks);
+    }
+    if (check_seek) {
+        // the same session stepped through from the beginning, with no keyframes to load
+        te::replay linear { replaying->recorded(), "", 0, params.threads };
+        linear.seek(until.value_or(linear.recorded().ticks()));
+        const auto expected = te::state_hash(linear.model());
+        const auto got = te::state_hash(model());
+        if (got != expected) {
+            spdlog::error("Seeking gave state hash {:016x} at tick {}, replaying from the start gave {:016x}", got, model().ticks, expected);
+            return 1;
+        }
+        fmt::print("seeking matches replaying from the start, state hash {:016x}\n", got);
+    }
+    if (auto& journal = model().journal; journal) {
+        fmt::print("journalled {} trades to {}, {} dropped\n", journal->appended(), trades_to, journal->dropped());
+        // waits for the writer to finish
+        journal.reset();
+    }
+    if (!profile_to.empty()) {
+        std::ofstream profile { profile_to };
+        if (!profile) {
+            spdlog::error("Couldn't open {} for writing", profile_to);
+            return 1;
+        }
+        if (profile_to.ends_with(".json")) {
+            te::write_profile_json(profile, model().profile);
+        } else {
+            te::write_profile_csv(profile, model().profile);
+        }
+        fmt::print("wrote timings of the last {} ticks to {}\n", model().profile.size(), profile_to);
+    }
+
+    if (!save_to.empty()) {
+        then = std::chrono::steady_clock::now();
+        try {
+            te::save_snapshot(model(), save_to);
+        } catch (const te::snapshot_error& e) {
+            spdlog::error("{}", e.what());
+            return 1;
+        }
+        std::chrono::duration<double> save_secs = std::chrono::steady_clock::now() - then;
+        fmt::print("saved {} entities to {} in {:.3f}s\n", model().entities.alive(), save_to, save_secs.count());
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include <te/interner.hpp>
+
+te::string_interner::string_interner() {
+    intern("");
+}
+
+te::string_id te::string_interner::intern(std::string_view s) {
+    std::lock_guard guard { lock };
+    if (auto found = ids.find(s); found != ids.end()) return found->second;
+    const string_id id { static_cast<std::uint32_t>(strings.size()) };
+    const auto& kept = strings.emplace_back(s);
+    ids.emplace(std::string_view { kept }, id);
+    return id;
+}
+
+const std::string& te::string_interner::str(string_id id) const {
+    std::lock_guard guard { lock };
+    return strings.at(id.index);
+}
+
+std::size_t te::string_interner::size() const {
+    std::lock_guard guard { lock };
+    return strings.size();
+}
+
+te::string_interner& te::interned_strings() {
+    static string_interner interner;
+    return interner;
+}
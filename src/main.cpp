@@ -1,6 +1,10 @@
 #include <te/sim.hpp>
 #include <te/app.hpp>
+#include <te/command_log.hpp>
+#include <memory>
+#include <string_view>
 #include <random>
+#include <thread>
 #include <spdlog/spdlog.h>
 #include <sys/resource.h>
 
@@ -12,8 +16,15 @@ int main(const int argc, const char** argv) {
     setrlimit(RLIMIT_CORE, &core_limits);
 
     auto seed = std::random_device{}();
-    te::sim model { seed };
-    te::app frontend { model, seed };
+    te::world_params params;
+    params.threads = std::thread::hardware_concurrency();
+    te::sim model { seed, params };
+    // --record FILE logs the session for replay by te_sim
+    std::unique_ptr<te::command_log> log;
+    if (argc == 3 && std::string_view{argv[1]} == "--record") {
+        log = std::make_unique<te::command_log>(argv[2], seed, params);
+    }
+    te::app frontend { model, seed, log.get() };
     frontend.run();
     return 0;
 }
@@ -0,0 +1,73 @@
+#include <te/merchant_lanes.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // restrict only promises the lanes don't overlap when it's on parameters
+    void advance_lanes (
+        std::size_t count,
+        float dt,
+        const float* __restrict destination_x,
+        const float* __restrict destination_y,
+        const float* __restrict speed,
+        float* __restrict x,
+        float* __restrict y,
+        float* __restrict slack,
+        std::uint8_t* __restrict arrived
+    ) {
+        constexpr float arrival_distance = te::merchant_lanes::arrival_distance;
+        // kept branch-free so that it vectorises: merchants who have arrived take a step of zero
+        for (std::size_t i = 0; i < count; i++) {
+            const float course_x = destination_x[i] - x[i];
+            const float course_y = destination_y[i] - y[i];
+            const float distance = std::sqrt(course_x * course_x + course_y * course_y);
+            const float moving = distance > arrival_distance ? 1.0f : 0.0f;
+            // never overshoot the destination
+            const float step = moving * std::min(speed[i] * dt, distance);
+            // divides by the distance for merchants who are moving, and by something non-zero for those who aren't
+            const float scale = step / (distance + (1.0f - moving));
+            x[i] += course_x * scale;
+            y[i] += course_y * scale;
+            slack[i] -= step;
+            arrived[i] = moving == 0.0f;
+        }
+    }
+}
+
+std::size_t te::merchant_lanes::size() const {
+    return merchants.size();
+}
+
+void te::merchant_lanes::clear() {
+    merchants.clear();
+    x.clear();
+    y.clear();
+    destination_x.clear();
+    destination_y.clear();
+    speed.clear();
+    slack.clear();
+    arrived.clear();
+}
+
+void te::merchant_lanes::push_back(entt::entity merchant, float x, float y, float destination_x, float destination_y, float speed) {
+    merchants.push_back(merchant);
+    this->x.push_back(x);
+    this->y.push_back(y);
+    this->destination_x.push_back(destination_x);
+    this->destination_y.push_back(destination_y);
+    this->speed.push_back(speed);
+    slack.push_back(-1.0f);
+    arrived.push_back(0);
+}
+
+bool te::merchant_lanes::matches(const entt::entity* others, std::size_t count) const {
+    return count == merchants.size() && std::equal(merchants.begin(), merchants.end(), others);
+}
+
+void te::merchant_lanes::advance(float dt) {
+    advance_lanes (
+        size(), dt,
+        destination_x.data(), destination_y.data(), speed.data(),
+        x.data(), y.data(), slack.data(), arrived.data()
+    );
+}
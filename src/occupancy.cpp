@@ -0,0 +1,176 @@
+#include <te/occupancy.hpp>
+#include <algorithm>
+
+namespace {
+    constexpr int chunk_size = te::occupancy_grid::chunk_size;
+    static_assert(chunk_size == 64, "a chunk row is exactly one word");
+
+    // bits [begin, end) of a row
+    std::uint64_t span_mask(int begin, int end) {
+        const std::uint64_t upto_end = end == chunk_size ? ~std::uint64_t{0} : (std::uint64_t{1} << end) - 1;
+        const std::uint64_t from_begin = ~((std::uint64_t{1} << begin) - 1);
+        return upto_end & from_begin;
+    }
+
+    bool overlaps(glm::ivec2 a_topleft, glm::ivec2 a_dimensions, glm::ivec2 b_topleft, glm::ivec2 b_dimensions) {
+        return a_topleft.x < b_topleft.x + b_dimensions.x
+            && b_topleft.x < a_topleft.x + a_dimensions.x
+            && a_topleft.y < b_topleft.y + b_dimensions.y
+            && b_topleft.y < a_topleft.y + a_dimensions.y;
+    }
+}
+
+te::occupancy_grid::chunk::chunk() {
+    owners.fill(entt::null);
+}
+
+void te::occupancy_grid::chunk::rebuild() {
+    constexpr std::size_t stride = chunk_size + 1;
+    std::fill(taken_before.begin(), taken_before.begin() + stride, 0);
+    for (int y = 0; y < chunk_size; y++) {
+        std::uint16_t in_row = 0;
+        taken_before[(y + 1) * stride] = 0;
+        for (int x = 0; x < chunk_size; x++) {
+            in_row += (rows[y] >> x) & 1;
+            taken_before[(y + 1) * stride + x + 1] = taken_before[y * stride + x + 1] + in_row;
+        }
+    }
+    pending_fills.clear();
+    pending_clears.clear();
+}
+
+void te::occupancy_grid::chunk::note(std::vector<rect>& pending, glm::ivec2 local, glm::ivec2 dimensions) {
+    if (pending_fills.size() + pending_clears.size() < max_pending) {
+        pending.push_back(rect { local, dimensions });
+    } else {
+        rebuild();
+    }
+}
+
+bool te::occupancy_grid::chunk::any_taken(glm::ivec2 local, glm::ivec2 dimensions) const {
+    auto overlapping = [&](const rect& changed) { return overlaps(local, dimensions, changed.topleft, changed.dimensions); };
+    // the table may count cells cleared since, so ask the bits, a row at a time
+    if (std::any_of(pending_clears.begin(), pending_clears.end(), overlapping)) {
+        const std::uint64_t mask = span_mask(local.x, local.x + dimensions.x);
+        for (int y = local.y; y < local.y + dimensions.y; y++) {
+            if (rows[y] & mask) return true;
+        }
+        return false;
+    }
+    constexpr std::size_t stride = chunk_size + 1;
+    const std::size_t top = static_cast<std::size_t>(local.y) * stride;
+    const std::size_t bottom = static_cast<std::size_t>(local.y + dimensions.y) * stride;
+    const int left = local.x;
+    const int right = local.x + dimensions.x;
+    const int taken = taken_before[bottom + right] - taken_before[top + right]
+                    - taken_before[bottom + left] + taken_before[top + left];
+    if (taken > 0) return true;
+    return std::any_of(pending_fills.begin(), pending_fills.end(), overlapping);
+}
+
+void te::occupancy_grid::chunk::fill(glm::ivec2 local, glm::ivec2 dimensions, entt::entity owner) {
+    const std::uint64_t mask = span_mask(local.x, local.x + dimensions.x);
+    for (int y = local.y; y < local.y + dimensions.y; y++) {
+        rows[y] |= mask;
+        auto owners_row = owners.begin() + static_cast<std::size_t>(y) * chunk_size;
+        std::fill(owners_row + local.x, owners_row + local.x + dimensions.x, owner);
+    }
+    note(pending_fills, local, dimensions);
+}
+
+void te::occupancy_grid::chunk::clear(glm::ivec2 local, glm::ivec2 dimensions) {
+    const std::uint64_t mask = span_mask(local.x, local.x + dimensions.x);
+    for (int y = local.y; y < local.y + dimensions.y; y++) {
+        rows[y] &= ~mask;
+        auto owners_row = owners.begin() + static_cast<std::size_t>(y) * chunk_size;
+        std::fill(owners_row + local.x, owners_row + local.x + dimensions.x, entt::entity{entt::null});
+    }
+    note(pending_clears, local, dimensions);
+}
+
+te::occupancy_grid::occupancy_grid(int width, int height) :
+    width { width },
+    height { height },
+    origin { -width / 2, -height / 2 },
+    chunk_counts { (width + chunk_size - 1) / chunk_size, (height + chunk_size - 1) / chunk_size },
+    chunks(static_cast<std::size_t>(chunk_counts.x) * chunk_counts.y)
+{
+}
+
+bool te::occupancy_grid::contains(glm::ivec2 topleft, glm::ivec2 dimensions) const {
+    const glm::ivec2 local = topleft - origin;
+    return local.x >= 0 && local.y >= 0
+        && local.x + dimensions.x <= width
+        && local.y + dimensions.y <= height;
+}
+
+bool te::occupancy_grid::is_free(glm::ivec2 topleft, glm::ivec2 dimensions) const {
+    if (!contains(topleft, dimensions)) return false;
+    bool free = true;
+    each_chunk(topleft - origin, dimensions,
+        [&](std::size_t chunk_ix, glm::ivec2 local, glm::ivec2 part) {
+            // chunks nothing was ever placed in are entirely free
+            free = !chunks[chunk_ix] || !chunks[chunk_ix]->any_taken(local, part);
+            return free;
+        }
+    );
+    return free;
+}
+
+void te::occupancy_grid::fill(glm::ivec2 topleft, glm::ivec2 dimensions, entt::entity owner) {
+    each_chunk(topleft - origin, dimensions,
+        [&](std::size_t chunk_ix, glm::ivec2 local, glm::ivec2 part) {
+            auto& the_chunk = chunks[chunk_ix];
+            if (!the_chunk) the_chunk = std::make_unique<chunk>();
+            the_chunk->fill(local, part, owner);
+            return true;
+        }
+    );
+}
+
+void te::occupancy_grid::clear(glm::ivec2 topleft, glm::ivec2 dimensions) {
+    each_chunk(topleft - origin, dimensions,
+        [&](std::size_t chunk_ix, glm::ivec2 local, glm::ivec2 part) {
+            if (chunks[chunk_ix]) chunks[chunk_ix]->clear(local, part);
+            return true;
+        }
+    );
+}
+
+std::optional<entt::entity> te::occupancy_grid::at(glm::ivec2 cell) const {
+    if (!contains(cell, {1, 1})) return std::nullopt;
+    const glm::ivec2 local = cell - origin;
+    const auto& the_chunk = chunks[static_cast<std::size_t>(local.y / chunk_size) * chunk_counts.x + local.x / chunk_size];
+    if (!the_chunk) return std::nullopt;
+    const glm::ivec2 in_chunk = local % chunk_size;
+    if (!((the_chunk->rows[in_chunk.y] >> in_chunk.x) & 1)) {
+        return std::nullopt;
+    }
+    return the_chunk->owners[static_cast<std::size_t>(in_chunk.y) * chunk_size + in_chunk.x];
+}
+
+std::size_t te::occupancy_grid::chunk_count() const {
+    return chunks.size();
+}
+
+const entt::entity* te::occupancy_grid::chunk_owners(std::size_t chunk_ix) const {
+    return chunks[chunk_ix] ? chunks[chunk_ix]->owners.data() : nullptr;
+}
+
+void te::occupancy_grid::restore_chunk(std::size_t chunk_ix, const entt::entity* owners) {
+    auto& the_chunk = chunks[chunk_ix];
+    if (!the_chunk) the_chunk = std::make_unique<chunk>();
+    std::copy(owners, owners + chunk_size * chunk_size, the_chunk->owners.begin());
+    for (int y = 0; y < chunk_size; y++) {
+        std::uint64_t row = 0;
+        for (int x = 0; x < chunk_size; x++) {
+            if (owners[y * chunk_size + x] != entt::null) row |= std::uint64_t{1} << x;
+        }
+        the_chunk->rows[y] = row;
+    }
+    the_chunk->rebuild();
+}
+
+std::size_t te::occupancy_grid::allocated_chunks() const {
+    return std::count_if(chunks.begin(), chunks.end(), [](const auto& the_chunk) { return the_chunk != nullptr; });
+}
@@ -0,0 +1,25 @@
+#include <te/order_book.hpp>
+#include <algorithm>
+
+void te::order_book::clear() {
+    bids.clear();
+    asks.clear();
+}
+
+void te::order_book::add(entt::entity trader, double bid) {
+    if (bid > 0.0) {
+        bids.push_back({trader, bid});
+    } else if (bid < 0.0) {
+        asks.push_back({trader, -bid});
+    }
+}
+
+void te::order_book::sort() {
+    // ties broken by entity so the matching order doesn't depend on insertion order
+    const auto largest_first = [](const order& lhs, const order& rhs) {
+        return lhs.quantity > rhs.quantity
+            || (lhs.quantity == rhs.quantity && lhs.trader < rhs.trader);
+    };
+    std::sort(bids.begin(), bids.end(), largest_first);
+    std::sort(asks.begin(), asks.end(), largest_first);
+}
@@ -0,0 +1,128 @@
+#include <te/profiler.hpp>
+#include <fmt/format.h>
+#include <ostream>
+#include <algorithm>
+#include <cstdint>
+
+const char* te::phase_name(tick_phase phase) {
+    switch (phase) {
+    case tick_phase::merchants: return "merchants";
+    case tick_phase::generators: return "generators";
+    case tick_phase::producers: return "producers";
+    case tick_phase::demanders: return "demanders";
+    case tick_phase::matching: return "matching";
+    case tick_phase::pricing: return "pricing";
+    case tick_phase::growth: return "growth";
+    case tick_phase::dwellings: return "dwellings";
+    }
+    return "unknown";
+}
+
+te::tick_history::tick_history(std::size_t capacity) {
+    set_capacity(capacity);
+}
+
+void te::tick_history::set_capacity(std::size_t capacity) {
+    slots.clear();
+    slots.shrink_to_fit();
+    capacity_ = capacity;
+    next = 0;
+    count = 0;
+}
+
+std::size_t te::tick_history::capacity() const {
+    return capacity_;
+}
+
+std::size_t te::tick_history::size() const {
+    return count;
+}
+
+void te::tick_history::clear() {
+    next = 0;
+    count = 0;
+}
+
+const te::tick_profile& te::tick_history::operator[](std::size_t i) const {
+    return slots[(next + capacity_ - count + i) % capacity_];
+}
+
+const te::tick_profile& te::tick_history::latest() const {
+    return (*this)[count - 1];
+}
+
+te::tick_profile* te::tick_history::record() {
+    if (capacity_ == 0) return nullptr;
+    // slots are only added while the ring first fills
+    if (slots.size() < capacity_) {
+        slots.emplace_back();
+    }
+    auto& slot = slots[next];
+    next = (next + 1) % capacity_;
+    count = std::min(count + 1, capacity_);
+    return &slot;
+}
+
+namespace {
+    void write_phase_times(std::ostream& out, const te::phase_times& times) {
+        out << '{';
+        for (std::size_t phase = 0; phase < te::tick_phase_count; phase++) {
+            out << fmt::format (
+                "{}\"{}\":{}",
+                phase == 0 ? "" : ",",
+                te::phase_name(static_cast<te::tick_phase>(phase)),
+                times[phase]
+            );
+        }
+        out << '}';
+    }
+}
+
+void te::write_profile_json(std::ostream& out, const tick_history& history) {
+    out << "[\n";
+    for (std::size_t i = 0; i < history.size(); i++) {
+        const auto& tick = history[i];
+        out << fmt::format (
+            "{{\"tick\":{},\"dt\":{},\"seconds\":{},\"merchants\":{},\"phases\":",
+            tick.tick, tick.dt, tick.seconds, tick.merchants
+        );
+        write_phase_times(out, tick.times);
+        out << ",\"markets\":[";
+        for (std::size_t j = 0; j < tick.markets.size(); j++) {
+            const auto& market = tick.markets[j];
+            out << fmt::format (
+                "{}{{\"market\":{},\"members\":{},\"phases\":",
+                j == 0 ? "" : ",",
+                static_cast<std::uint32_t>(market.market),
+                market.members
+            );
+            write_phase_times(out, market.times);
+            out << '}';
+        }
+        out << "]}" << (i + 1 < history.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+void te::write_profile_csv(std::ostream& out, const tick_history& history) {
+    out << "tick,dt,market,members";
+    for (std::size_t phase = 0; phase < tick_phase_count; phase++) {
+        out << ',' << phase_name(static_cast<tick_phase>(phase));
+    }
+    out << '\n';
+    auto write_times = [&](const phase_times& times) {
+        for (auto secs : times) {
+            out << fmt::format(",{}", secs);
+        }
+        out << '\n';
+    };
+    for (std::size_t i = 0; i < history.size(); i++) {
+        const auto& tick = history[i];
+        out << fmt::format("{},{},-1,{}", tick.tick, tick.dt, tick.merchants);
+        write_times(tick.times);
+        for (const auto& market : tick.markets) {
+            out << fmt::format("{},{},{},{}", tick.tick, tick.dt, static_cast<std::uint32_t>(market.market), market.members);
+            write_times(market.times);
+        }
+    }
+}
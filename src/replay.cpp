@@ -0,0 +1,239 @@
+#include <te/replay.hpp>
+#include <te/snapshot.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+#include <variant>
+
+namespace {
+    // lists the keyframes in a keyframe directory, one per line after a header
+    constexpr const char* index_name = "keyframes.index";
+
+    // FNV-1a, a field at a time so that padding doesn't get in
+    template<typename T>
+    void fold(std::uint64_t& digest, const T& field) {
+        static_assert(std::is_arithmetic_v<T>);
+        const auto* bytes = reinterpret_cast<const unsigned char*>(&field);
+        for (std::size_t i = 0; i < sizeof(T); i++) {
+            digest = (digest ^ bytes[i]) * 0x100000001b3ull;
+        }
+    }
+
+    void fold(std::uint64_t& digest, const std::optional<glm::vec2>& where) {
+        fold(digest, where.has_value());
+        if (where) {
+            fold(digest, where->x);
+            fold(digest, where->y);
+        }
+    }
+
+    std::uint64_t start_digest(const te::recorded_session& session) {
+        std::uint64_t digest = 0xcbf29ce484222325ull;
+        fold(digest, session.seed);
+        fold(digest, session.params.map_width);
+        fold(digest, session.params.map_height);
+        fold(digest, session.params.buildings);
+        fold(digest, session.params.tile_size);
+        fold(digest, session.params.spacing);
+        return digest;
+    }
+
+    std::uint64_t folded(std::uint64_t digest, const te::command& cmd) {
+        fold(digest, cmd.index());
+        std::visit([&](const auto& c) {
+            using T = std::decay_t<decltype(c)>;
+            if constexpr (std::is_same_v<T, te::tick_command>) {
+                fold(digest, c.dt);
+                fold(digest, c.count);
+            } else if constexpr (std::is_same_v<T, te::pick_up_command>) {
+                fold(digest, c.blueprint_ix);
+            } else if constexpr (std::is_same_v<T, te::move_ghost_command>) {
+                fold(digest, c.where.x);
+                fold(digest, c.where.y);
+            } else if constexpr (std::is_same_v<T, te::place_ghost_command>) {
+                fold(digest, c.family_ix);
+            } else {
+                static_assert(std::is_same_v<T, te::focus_command>);
+                fold(digest, c.policy.focus);
+                fold(digest, c.policy.radius);
+                fold(digest, c.policy.inspected);
+                fold(digest, c.policy.stride);
+            }
+        }, cmd);
+        return digest;
+    }
+}
+
+te::replay::replay(recorded_session session, std::string keyframe_dir, long keyframe_interval, std::size_t threads) :
+    session { std::move(session) },
+    keyframe_dir { std::move(keyframe_dir) },
+    keyframe_interval { keyframe_interval },
+    threads { threads },
+    total_ticks { this->session.ticks() }
+{
+    if (this->keyframe_interval > 0) {
+        std::filesystem::create_directories(this->keyframe_dir);
+    }
+    if (!this->keyframe_dir.empty()) {
+        read_keyframes();
+    }
+    restart();
+}
+
+te::sim& te::replay::model() {
+    return *current;
+}
+
+const te::recorded_session& te::replay::recorded() const {
+    return session;
+}
+
+long te::replay::tick() const {
+    return current->ticks;
+}
+
+void te::replay::restart() {
+    auto params = session.params;
+    params.threads = threads;
+    swap_in(std::make_unique<sim>(session.seed, params));
+    at = cursor {};
+    at.digest = start_digest(session);
+}
+
+void te::replay::swap_in(std::unique_ptr<sim> next) {
+    if (current && on_swap) on_swap(*current, *next);
+    current = std::move(next);
+}
+
+void te::replay::save_keyframe() {
+    const long now = current->ticks;
+    if (!keyframes.empty() && keyframes.back().tick >= now) return;
+    auto filename = fmt::format("{}/{:012}.snap", keyframe_dir, now);
+    save_snapshot(*current, filename);
+    keyframes.push_back(keyframe { now, at, std::move(filename) });
+    write_keyframes();
+}
+
+// Keyframes left by an earlier replay are only used if everything before them is the same in
+// this session, so a directory reused for a different log, or for one that has since been
+// recorded further, doesn't start a seek from the wrong state.
+void te::replay::read_keyframes() {
+    std::ifstream index { fmt::format("{}/{}", keyframe_dir, index_name) };
+    if (!index) return;
+    std::string magic;
+    std::uint32_t version = 0;
+    if (!(index >> magic >> version) || magic != "te-keyframes" || version != snapshot_version) {
+        spdlog::warn("Ignoring the keyframes in {}, they're from another version", keyframe_dir);
+        return;
+    }
+    std::vector<keyframe> found;
+    keyframe frame;
+    std::string name;
+    while (index >> frame.tick >> frame.cursor.next_command >> frame.cursor.ticks_done >> std::hex >> frame.cursor.digest >> std::dec >> name) {
+        frame.filename = fmt::format("{}/{}", keyframe_dir, name);
+        found.push_back(frame);
+    }
+    std::sort(found.begin(), found.end(), [](const keyframe& a, const keyframe& b) {
+        return a.cursor.next_command < b.cursor.next_command;
+    });
+
+    // walk the session once, checking each keyframe as its place comes up
+    std::uint64_t digest = start_digest(session);
+    std::size_t next_command = 0;
+    long ticks = 0;
+    for (const auto& candidate : found) {
+        if (candidate.cursor.next_command > session.commands.size()) break;
+        for (; next_command < candidate.cursor.next_command; next_command++) {
+            const auto& cmd = session.commands[next_command];
+            if (auto run = std::get_if<tick_command>(&cmd); run) ticks += run->count;
+            digest = folded(digest, cmd);
+        }
+        if (candidate.cursor.digest != digest) continue;
+        if (candidate.cursor.ticks_done > 0) {
+            // part way through a run of ticks, which may since have grown but not changed
+            if (candidate.cursor.next_command == session.commands.size()) continue;
+            auto run = std::get_if<tick_command>(&session.commands[candidate.cursor.next_command]);
+            if (!run || run->count <= candidate.cursor.ticks_done) continue;
+        }
+        if (candidate.tick != ticks + candidate.cursor.ticks_done) continue;
+        if (!std::filesystem::exists(candidate.filename)) continue;
+        keyframes.push_back(candidate);
+    }
+    std::sort(keyframes.begin(), keyframes.end(), [](const keyframe& a, const keyframe& b) {
+        return a.tick < b.tick;
+    });
+    if (keyframes.size() < found.size()) {
+        spdlog::warn("Ignoring {} of the keyframes in {}, they're from another session", found.size() - keyframes.size(), keyframe_dir);
+    }
+}
+
+void te::replay::write_keyframes() const {
+    const auto filename = fmt::format("{}/{}", keyframe_dir, index_name);
+    const auto partial = filename + ".partial";
+    {
+        std::ofstream index { partial, std::ios::trunc };
+        index << "te-keyframes " << snapshot_version << '\n';
+        for (const auto& frame : keyframes) {
+            index << fmt::format (
+                "{} {} {} {:016x} {}\n",
+                frame.tick, frame.cursor.next_command, frame.cursor.ticks_done, frame.cursor.digest,
+                std::filesystem::path { frame.filename }.filename().string()
+            );
+        }
+        if (!index.flush()) {
+            throw std::runtime_error(fmt::format("Couldn't write {}", partial));
+        }
+    }
+    std::filesystem::rename(partial, filename);
+}
+
+bool te::replay::step() {
+    if (at.next_command >= session.commands.size()) return false;
+    const auto& cmd = session.commands[at.next_command];
+    if (auto ticks = std::get_if<tick_command>(&cmd); ticks) {
+        // runs of ticks are taken one at a time, so a keyframe can fall in the middle of one
+        apply(*current, tick_command { ticks->dt, 1 });
+        if (++at.ticks_done == ticks->count) {
+            at.digest = folded(at.digest, cmd);
+            at.next_command++;
+            at.ticks_done = 0;
+        }
+        if (keyframe_interval > 0 && current->ticks % keyframe_interval == 0) {
+            save_keyframe();
+        }
+    } else {
+        apply(*current, cmd);
+        at.digest = folded(at.digest, cmd);
+        at.next_command++;
+    }
+    return true;
+}
+
+void te::replay::seek(long target) {
+    // the latest keyframe no later than the target
+    auto after = std::upper_bound (
+        keyframes.begin(),
+        keyframes.end(),
+        target,
+        [](long tick, const keyframe& frame) { return tick < frame.tick; }
+    );
+    if (after != keyframes.begin()) {
+        const auto& frame = *std::prev(after);
+        // only worth loading if it's ahead of where we are, or we need to go back
+        if (frame.tick > current->ticks || target < current->ticks) {
+            swap_in(load_snapshot(frame.filename, threads));
+            at = frame.cursor;
+        }
+    } else if (target < current->ticks) {
+        restart();
+    }
+    while (current->ticks < target && step()) {
+    }
+    if (target >= total_ticks) {
+        while (step()) {
+        }
+    }
+}
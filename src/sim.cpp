@@ -1,99 +1,299 @@
 #include <te/sim.hpp>
+#include <te/render_components.hpp>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <limits>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
 
-te::sim::sim(unsigned int seed) : rengine { seed } {
-    init_blueprints();
-    generate_map();
+namespace {
+    // units a generator makes before it stops to wait for some to be sold
+    constexpr int generator_capacity = 10;
+
+    // grid cell at the top-left corner of a footprint centred on centre
+    glm::ivec2 topleft_cell(glm::vec2 centre, const te::footprint& print) {
+        return glm::ivec2{glm::round(centre - print.dimensions / 2.0f)};
+    }
+
+    // Everything in an index that could be within radius of centre, in the order of their entities
+    // rather than where the index happens to keep them, as that isn't kept in snapshots. Callers
+    // check the distance themselves; this errs on the side of including.
+    std::vector<entt::entity> sites_around(const te::site_index& index, glm::vec2 centre, double radius) {
+        const float reach = static_cast<float>(radius) + 1.0f / 1024.0f;
+        std::vector<entt::entity> found;
+        index.each_in_rect(centre - reach, centre + reach, [&](entt::entity entity, glm::vec2) {
+            found.push_back(entity);
+        });
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+
+    template<typename... Component>
+    struct component_list {};
+
+    // What buildings are given of their blueprints, by both instantiate and instantiate_many.
+    // A blueprint's components that aren't listed here are left behind.
+    using building_components = component_list <
+        te::named, te::price, te::footprint, te::dweller, te::demander, te::trader, te::generator, te::producer,
+        te::inventory, te::market, te::merchant, te::render_mesh, te::render_tex, te::pickable
+    >;
+
+    // a position's bits, for telling markets apart by where they stand
+    std::uint64_t position_key(glm::vec2 position) {
+        std::uint32_t x;
+        std::uint32_t y;
+        std::memcpy(&x, &position.x, sizeof(x));
+        std::memcpy(&y, &position.y, sizeof(y));
+        return std::uint64_t{x} << 32 | y;
+    }
+
+    // copy each of the listed components proto has to every one of copies, a pool at a time
+    template<typename... Component>
+    void clone_columns(entt::registry& registry, entt::entity proto, const std::vector<entt::entity>& copies, component_list<Component...>) {
+        auto clone_column = [&](auto tag) {
+            using column = typename decltype(tag)::type;
+            if (!registry.has<column>(proto)) return;
+            // one at a time, the pool's own growth does better than reserving exactly
+            if (copies.size() > 1) registry.reserve<column>(registry.size<column>() + copies.size());
+            if constexpr (std::is_empty_v<column>) {
+                registry.assign<column>(copies.begin(), copies.end());
+            } else {
+                // copied out first, as the pool may move as it grows
+                const column original = registry.get<column>(proto);
+                registry.assign<column>(copies.begin(), copies.end(), original);
+            }
+        };
+        (clone_column(std::type_identity<Component>{}), ...);
+    }
+}
+
+te::sim::sim(unsigned int seed, world_params params) :
+    seed { seed },
+    map_width { params.map_width },
+    map_height { params.map_height }
+{
+    declare_groups();
+    watch_sites();
+    set_threads(params.threads);
+    if (params.generate) {
+        init_blueprints();
+        generate_map(params.buildings, params.tile_size, params.spacing);
+    }
+}
+
+void te::sim::clear() {
+    entities = entt::registry{};
+    declare_groups();
+    sites.clear();
+    market_sites.clear();
+    widest_market = 0.0;
+    watch_sites();
+    families.clear();
+    commodities.clear();
+    blueprints.clear();
+    routes.clear();
+    merchant_blueprint = entt::null;
+    market_influencees.clear();
+    influencee_markets.clear();
+    lanes.clear();
+    grid = occupancy_grid { map_width, map_height };
+    ticks = 0;
+    time = 0.0;
+    tick_times = {};
+    profile.clear();
+    lod = {};
+    lod_work = {};
+}
+
+std::string te::display_name(entt::entity entity, const named& the_named) {
+    if (!the_named.numbered) return str(the_named.name);
+    return fmt::format("{} (#{})", str(the_named.name), static_cast<unsigned>(entity));
+}
+
+void te::sim::declare_groups() {
+    entities.group<trader, inventory>();
+}
+
+void te::sim::watch_sites() {
+    entities.on_construct<site>().connect<&sim::site_added>(*this);
+    entities.on_replace<site>().connect<&sim::site_replaced>(*this);
+    entities.on_destroy<site>().connect<&sim::site_removed>(*this);
+    entities.on_construct<market>().connect<&sim::market_added>(*this);
+    entities.on_destroy<market>().connect<&sim::market_removed>(*this);
+}
+
+// a market may be given its site before or after its market, so whichever comes second indexes it
+void te::sim::site_added(entt::registry& registry, entt::entity entity, site& the_site) {
+    sites.insert(entity, the_site.position);
+    if (registry.has<market>(entity)) market_sites.insert(entity, the_site.position);
+}
+
+void te::sim::site_replaced(entt::registry&, entt::entity entity, site& the_site) {
+    sites.move(entity, the_site.position);
+    if (market_sites.contains(entity)) market_sites.move(entity, the_site.position);
+}
+
+void te::sim::site_removed(entt::registry&, entt::entity entity) {
+    sites.erase(entity);
+    market_sites.erase(entity);
+}
+
+// merchants' slack is only good while the markets around them stay put, so they all look again
+void te::sim::market_added(entt::registry& registry, entt::entity entity, market& the_market) {
+    widest_market = std::max(widest_market, the_market.radius);
+    if (auto maybe_site = registry.try_get<site>(entity); maybe_site) market_sites.insert(entity, maybe_site->position);
+    std::fill(lanes.slack.begin(), lanes.slack.end(), -1.0f);
+}
+
+void te::sim::market_removed(entt::registry&, entt::entity entity) {
+    market_sites.erase(entity);
+    std::fill(lanes.slack.begin(), lanes.slack.end(), -1.0f);
 }
 
 void te::sim::init_blueprints() {
     families.resize(3);
     // Commodities
-    auto wheat = commodities.emplace_back(entities.create());
-    entities.assign<named>(wheat, "Wheat");
-    entities.assign<price>(wheat, 15.0);
-    entities.assign<render_tex>(wheat, "media/wheat.png");
+    const std::size_t wheat = commodities.size();
+    auto wheat_e = commodities.emplace_back(entities.create());
+    entities.assign<named>(wheat_e, intern("Wheat"));
+    entities.assign<price>(wheat_e, 15.0);
+    entities.assign<render_tex>(wheat_e, intern("media/wheat.png"));
 
-    auto barley = commodities.emplace_back(entities.create());
-    entities.assign<named>(barley, "Barley");
-    entities.assign<price>(barley, 10.0);
-    entities.assign<render_tex>(barley, "media/wheat.png");
+    const std::size_t barley = commodities.size();
+    auto barley_e = commodities.emplace_back(entities.create());
+    entities.assign<named>(barley_e, intern("Barley"));
+    entities.assign<price>(barley_e, 10.0);
+    entities.assign<render_tex>(barley_e, intern("media/wheat.png"));
 
-    auto flour = commodities.emplace_back(entities.create());
-    entities.assign<named>(flour, "Flour");
-    entities.assign<price>(flour, 30.0);
-    entities.assign<render_tex>(flour, "media/flour.png");
+    const std::size_t flour = commodities.size();
+    auto flour_e = commodities.emplace_back(entities.create());
+    entities.assign<named>(flour_e, intern("Flour"));
+    entities.assign<price>(flour_e, 30.0);
+    entities.assign<render_tex>(flour_e, intern("media/flour.png"));
 
-    std::unordered_map<entt::entity, double> base_market_prices;
-    for (auto e : commodities) {
-        base_market_prices[e] = entities.get<price>(e).price;
+    if (commodities.size() > max_commodities) {
+        throw std::runtime_error("Too many commodities, raise te::max_commodities");
+    }
+
+    per_commodity<double> base_market_prices;
+    for (std::size_t commodity = 0; commodity < commodities.size(); commodity++) {
+        base_market_prices[commodity] = entities.get<price>(commodities[commodity]).price;
     }
 
     // Buildings
     auto wheat_field = blueprints.emplace_back(entities.create());
-    entities.assign<named>(wheat_field, "Wheat Field");
+    entities.assign<named>(wheat_field, intern("Wheat Field"));
     entities.assign<footprint>(wheat_field, glm::vec2{2.0f,2.0f});
     entities.assign<generator>(wheat_field, wheat, 1.0 / 4.0);
     entities.assign<inventory>(wheat_field);
     entities.assign<trader>(wheat_field, 0u);
-    entities.assign<render_mesh>(wheat_field, "media/wheat.glb");
+    entities.assign<render_mesh>(wheat_field, intern("media/wheat.glb"));
     entities.assign<pickable>(wheat_field);
 
     auto barley_field = blueprints.emplace_back(entities.create());
-    entities.assign<named>(barley_field, "Barley Field");
+    entities.assign<named>(barley_field, intern("Barley Field"));
     entities.assign<footprint>(barley_field, glm::vec2{2.0f,2.0f});
     entities.assign<generator>(barley_field, barley, 1.0 / 3.0);
     entities.assign<inventory>(barley_field);
     entities.assign<trader>(barley_field, 0u);
-    entities.assign<render_mesh>(barley_field, "media/barley.glb");
+    entities.assign<render_mesh>(barley_field, intern("media/barley.glb"));
     entities.assign<pickable>(barley_field);
 
     auto dwelling = blueprints.emplace_back(entities.create());
-    entities.assign<named>(dwelling, "Dwelling");
+    entities.assign<named>(dwelling, intern("Dwelling"));
     entities.assign<footprint>(dwelling, glm::vec2{1.0f,1.0f});
     demander& dwelling_demander = entities.assign<demander>(dwelling);
     dwelling_demander.rate[wheat] = 0.0005f;
     dwelling_demander.rate[barley] = 0.0004f;
     entities.assign<dweller>(dwelling);
-    entities.assign<render_mesh>(dwelling, "media/dwelling.glb");
+    entities.assign<render_mesh>(dwelling, intern("media/dwelling.glb"));
     entities.assign<pickable>(dwelling);
     
     auto market = blueprints.emplace_back(entities.create());
-    entities.assign<named>(market, "Market");
+    entities.assign<named>(market, intern("Market"));
     entities.assign<price>(market, 900.0);
     entities.assign<footprint>(market, glm::vec2{2.0f,2.0f});
     entities.assign<te::market>(market, base_market_prices);
-    entities.assign<render_mesh>(market, "media/market.glb");
+    entities.assign<render_mesh>(market, intern("media/market.glb"));
     entities.assign<pickable>(market);
 
     auto mill = blueprints.emplace_back(entities.create());
-    entities.assign<named>(mill, "Flour Mill");
+    entities.assign<named>(mill, intern("Flour Mill"));
     entities.assign<footprint>(mill, glm::vec2{1.0f, 1.0f});
-    std::unordered_map<entt::entity, double> inputs;
+    per_commodity<double> inputs;
     inputs[wheat] = 4.0;
-    std::unordered_map<entt::entity, double> outputs;
+    per_commodity<double> outputs;
     outputs[flour] = 1.0;
     entities.assign<inventory>(mill);
     entities.assign<producer>(mill, inputs, outputs, 1.0 / 6.0);
     entities.assign<trader>(mill, 0u);
     entities.assign<price>(mill, 550.0);
-    entities.assign<render_mesh>(mill, "media/mill.glb");
+    entities.assign<render_mesh>(mill, intern("media/mill.glb"));
     entities.assign<pickable>(mill);
 }
 
-void te::sim::generate_map() {
-    std::discrete_distribution<std::size_t> select_blueprint {7, 7, 2, 1, 2};
-    for (int i = 0; i < 100; i++) spawn(blueprints[select_blueprint(rengine)]);
+void te::sim::generate_map(int buildings, int tile_size, int spacing) {
+    if (tile_size < 1) {
+        throw std::runtime_error("Generation tiles must be at least one cell across");
+    }
+    // relative frequency of each blueprint
+    const double weights[] = {7, 7, 2, 1, 2};
+    if (blueprints.size() > std::size(weights)) {
+        throw std::runtime_error("Some blueprints have no generation weight, add them to generate_map");
+    }
+    std::vector<blueprint_shape> shapes;
+    for (std::size_t blueprint_ix = 0; blueprint_ix < blueprints.size(); blueprint_ix++) {
+        const auto blueprint = blueprints[blueprint_ix];
+        std::optional<double> market_radius;
+        if (auto maybe_market = entities.try_get<market>(blueprint); maybe_market) {
+            market_radius = maybe_market->radius;
+        }
+        shapes.push_back(blueprint_shape {
+            glm::ivec2{entities.get<footprint>(blueprint).dimensions},
+            weights[blueprint_ix],
+            market_radius
+        });
+    }
+
+    const world_tiling tiling { glm::ivec2{map_width, map_height}, tile_size };
+    std::vector<tile_plan> plans(tiling.size());
+    auto plan_one = [&](std::size_t tile_ix) {
+        const auto [topleft, dimensions] = tiling.tile(tile_ix);
+        plans[tile_ix] = plan_tile(shapes, topleft, dimensions, tiling.share(tile_ix, buildings), spacing, seed, tile_ix);
+    };
+    if (workers) {
+        workers->run(plans.size(), plan_one);
+    } else {
+        for (std::size_t tile_ix = 0; tile_ix < plans.size(); tile_ix++) plan_one(tile_ix);
+    }
+
+    // Plans can't conflict with each other, so they're committed as they are, in tile order and
+    // a blueprint at a time. Markets keep their members within their own tile, so each batch
+    // joins the same markets the plan put its buildings in.
+    std::vector<std::vector<glm::vec2>> centres(blueprints.size());
+    for (const auto& plan : plans) {
+        for (auto& blueprint_centres : centres) blueprint_centres.clear();
+        for (const auto& building : plan.buildings) {
+            const auto& shape = shapes[building.blueprint_ix];
+            centres[building.blueprint_ix].push_back(glm::vec2{building.topleft} + glm::vec2{shape.dimensions} / 2.0f);
+        }
+        for (std::size_t blueprint_ix = 0; blueprint_ix < blueprints.size(); blueprint_ix++) {
+            if (!centres[blueprint_ix].empty()) instantiate_many(blueprints[blueprint_ix], centres[blueprint_ix]);
+        }
+    }
     // create a roaming merchant
     auto merchant_e = entities.create();
-    entities.assign<named>(merchant_e, "Nebuchadnezzar");
+    entities.assign<named>(merchant_e, intern("Nebuchadnezzar"));
     entities.assign<site>(merchant_e, glm::vec2{0.0f, 0.0f});
     entities.assign<footprint>(merchant_e, glm::vec2{1.0f, 1.0f});
-    entities.assign<render_mesh>(merchant_e, "media/merchant.glb");
+    entities.assign<render_mesh>(merchant_e, intern("media/merchant.glb"));
     entities.assign<pickable>(merchant_e);
     entities.assign<trader>(merchant_e, 1u);
     entities.assign<inventory>(merchant_e);
     entities.assign<merchant>(merchant_e, std::nullopt);
+    join_markets(merchant_e);
 
     routes.push_back (
         route {
@@ -104,51 +304,275 @@ void te::sim::generate_map() {
 }
 
 te::market* te::sim::market_at(glm::vec2 x) {
-    auto markets = entities.view<market, site>();
-    auto it = std::find_if (
-        markets.begin(),
-        markets.end(),
-        [&](auto& e) {
-            auto& market_site = markets.get<site>(e);
-            auto& the_market = markets.get<market>(e);
-            return glm::length(glm::vec2{market_site.position - x}) <= the_market.radius;
+    for (auto market_e : sites_around(market_sites, x, widest_market)) {
+        const auto& [market_site, the_market] = entities.get<site, market>(market_e);
+        if (glm::length(glm::vec2{market_site.position - x}) <= the_market.radius) {
+            return &the_market;
         }
-    );
-    if (it != markets.end()) {
-        return &markets.get<market>(*it);
-    } else {
-        return nullptr;
-    };
+    }
+    return nullptr;
+}
+
+namespace {
+    std::int64_t bid_demand(double bid) {
+        //TODO: make bids only in increments
+        return bid > 0.0 ? static_cast<std::int64_t>(std::floor(bid * 100.0)) : 0;
+    }
+
+    double bid_supply(double bid) {
+        return bid < 0.0 ? -bid : 0.0;
+    }
+
+    // only whole units change hands, and a seller only sells what it has
+    bool can_trade(double bid, int stock) {
+        return bid >= 1.0 || (bid <= -1.0 && stock > 0);
+    }
+}
+
+void te::market::adjust_bid(std::size_t commodity, double old_bid, double new_bid) {
+    demand_hundredths[commodity] += bid_demand(new_bid) - bid_demand(old_bid);
+    demand[commodity] = demand_hundredths[commodity] / 100.0;
+    supply[commodity] += bid_supply(new_bid) - bid_supply(old_bid);
+}
+
+void te::market::set_bid(entt::entity member_e, trader& member, std::size_t commodity, double bid) {
+    adjust_bid(commodity, member.bid[commodity], bid);
+    member.bid[commodity] = bid;
+    if (bid != 0.0) wake_trader(member_e, commodity);
+}
+
+void te::market::wake_trader(entt::entity member_e, std::size_t commodity) {
+    // may already be awake; repeats are dropped when the commodity is next matched
+    awake[commodity].push_back(member_e);
+}
+
+void te::market::add_trader(entt::entity member_e, const trader& member) {
+    for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+        demand_hundredths[commodity] += bid_demand(member.bid[commodity]);
+        demand[commodity] = demand_hundredths[commodity] / 100.0;
+        supply[commodity] += bid_supply(member.bid[commodity]);
+        if (member.bid[commodity] != 0.0) wake_trader(member_e, commodity);
+    }
+}
+
+void te::market::remove_trader(const trader& member) {
+    for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+        demand_hundredths[commodity] -= bid_demand(member.bid[commodity]);
+        demand[commodity] = demand_hundredths[commodity] / 100.0;
+        supply[commodity] -= bid_supply(member.bid[commodity]);
+    }
 }
 
 bool te::sim::in_market(const site& question_site, const site& market_site, const market& the_market) const {
     return glm::length(glm::vec2{question_site.position - market_site.position}) <= the_market.radius;
 }
+
+const std::vector<entt::entity>& te::sim::members_of(entt::entity market_e) const {
+    static const std::vector<entt::entity> none;
+    auto members_it = market_influencees.find(market_e);
+    return members_it == market_influencees.end() ? none : members_it->second;
+}
+
+void te::sim::set_threads(std::size_t threads) {
+    if (threads > 1) {
+        workers = std::make_unique<worker_pool>(threads);
+    } else {
+        workers.reset();
+    }
+}
+
+bool te::sim::is_member(entt::entity market_e, entt::entity entity) const {
+    auto markets_it = influencee_markets.find(entity);
+    if (markets_it == influencee_markets.end()) return false;
+    const auto& markets = markets_it->second;
+    return std::find(markets.begin(), markets.end(), market_e) != markets.end();
+}
+
+void te::sim::add_member(entt::entity market_e, entt::entity entity) {
+    if (is_member(market_e, entity)) return;
+    market_influencees[market_e].push_back(entity);
+    influencee_markets[entity].push_back(market_e);
+    auto& the_market = entities.get<market>(market_e);
+    if (auto member_trader = entities.try_get<trader>(entity); member_trader) {
+        the_market.add_trader(entity, *member_trader);
+    }
+    if (entities.has<dweller>(entity)) {
+        the_market.population++;
+    }
+    if (auto member_demander = entities.try_get<demander>(entity); member_demander) {
+        for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+            the_market.demand_rate[commodity] += member_demander->rate[commodity];
+        }
+    }
+    // a generator with room starts on its next unit, a producer looks for its inputs
+    if (auto [member_generator, member_inventory] = entities.try_get<generator, inventory>(entity); member_generator && member_inventory) {
+        if (!member_generator->due && member_inventory->stock[member_generator->output] < generator_capacity) {
+            member_generator->due = time + 1.0 / member_generator->rate;
+        }
+        if (member_generator->due) the_market.generator_schedule.schedule(entity, *member_generator->due);
+    }
+    if (auto member_producer = entities.try_get<producer>(entity); member_producer) {
+        if (!member_producer->due) member_producer->due = time;
+        the_market.producer_schedule.schedule(entity, *member_producer->due);
+    }
+}
+
+void te::sim::wake(market& the_market, entt::entity building) {
+    auto building_inventory = entities.try_get<inventory>(building);
+    if (!building_inventory) return;
+    const auto& stock = building_inventory->stock;
+    if (auto the_generator = entities.try_get<generator>(building); the_generator && !the_generator->due) {
+        if (stock[the_generator->output] < generator_capacity) {
+            the_generator->due = time;
+            the_market.generator_schedule.schedule(building, time);
+        }
+    }
+    if (auto the_producer = entities.try_get<producer>(building); the_producer && !the_producer->due) {
+        bool enough = true;
+        for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+            enough &= stock[commodity] >= the_producer->inputs[commodity];
+        }
+        if (enough) {
+            the_producer->due = time;
+            the_market.producer_schedule.schedule(building, time);
+        }
+    }
+}
+
+namespace {
+    void swap_remove(std::vector<entt::entity>& entities, entt::entity entity) {
+        auto it = std::find(entities.begin(), entities.end(), entity);
+        if (it != entities.end()) {
+            *it = entities.back();
+            entities.pop_back();
+        }
+    }
+}
+
+void te::sim::remove_member(entt::entity market_e, entt::entity entity) {
+    if (!is_member(market_e, entity)) return;
+    swap_remove(market_influencees[market_e], entity);
+    swap_remove(influencee_markets[entity], market_e);
+    auto& the_market = entities.get<market>(market_e);
+    if (auto member_trader = entities.try_get<trader>(entity); member_trader) {
+        the_market.remove_trader(*member_trader);
+    }
+    if (entities.has<dweller>(entity)) {
+        the_market.population--;
+    }
+    if (entities.has<demander>(entity)) {
+        recount_demand_rate(market_e);
+    }
+}
+
+void te::sim::recount_demand_rate(entt::entity market_e) {
+    auto& the_market = entities.get<market>(market_e);
+    the_market.demand_rate = {};
+    for (auto member_e : members_of(market_e)) {
+        if (auto member_demander = entities.try_get<demander>(member_e); member_demander) {
+            for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+                the_market.demand_rate[commodity] += member_demander->rate[commodity];
+            }
+        }
+    }
+}
+
+void te::sim::set_bid(entt::entity trader_e, std::size_t commodity, double bid) {
+    auto& the_trader = entities.get<trader>(trader_e);
+    if (auto markets_it = influencee_markets.find(trader_e); markets_it != influencee_markets.end()) {
+        for (auto market_e : markets_it->second) {
+            auto& the_market = entities.get<market>(market_e);
+            the_market.adjust_bid(commodity, the_trader.bid[commodity], bid);
+            if (bid != 0.0) the_market.wake_trader(trader_e, commodity);
+        }
+    }
+    the_trader.bid[commodity] = bid;
+}
+
+void te::sim::join_markets(entt::entity entity) {
+    const auto entity_site = entities.get<site>(entity);
+    for (auto market_e : sites_around(market_sites, entity_site.position, widest_market)) {
+        const auto& [market_site, the_market] = entities.get<site, market>(market_e);
+        if (in_market(entity_site, market_site, the_market)) {
+            add_member(market_e, entity);
+        }
+    }
+    // a new market takes in everything already within its radius
+    if (auto maybe_market = entities.try_get<market>(entity); maybe_market) {
+        for (auto other : sites_around(sites, entity_site.position, maybe_market->radius)) {
+            if (!entities.has<ghost>(other) && in_market(entities.get<site>(other), entity_site, *maybe_market)) {
+                add_member(entity, other);
+            }
+        }
+    }
+}
+
+void te::sim::leave_markets(entt::entity entity) {
+    if (auto markets_it = influencee_markets.find(entity); markets_it != influencee_markets.end()) {
+        const auto markets = markets_it->second;
+        for (auto market_e : markets) {
+            remove_member(market_e, entity);
+        }
+        influencee_markets.erase(entity);
+    }
+    if (auto members_it = market_influencees.find(entity); members_it != market_influencees.end()) {
+        for (auto member : members_it->second) {
+            swap_remove(influencee_markets[member], entity);
+        }
+        market_influencees.erase(members_it);
+    }
+}
+
+float te::sim::update_markets(entt::entity entity) {
+    const auto& entity_site = entities.get<site>(entity);
+    // a little short, so that rounding as the entity moves can't carry it over an edge unnoticed
+    const float margin = 1.0f / 1024.0f;
+    // Markets are only looked for this far away; any further off are at least widest_market from
+    // their edges, so that's as much slack as the search can vouch for.
+    const double search = 2.0 * widest_market;
+    float slack = static_cast<float>(search - widest_market) - margin;
+    if (auto joined = influencee_markets.find(entity); joined != influencee_markets.end()) {
+        // copied, as leaving changes it
+        const auto was_in = joined->second;
+        for (auto market_e : was_in) {
+            const auto& [market_site, the_market] = entities.get<site, market>(market_e);
+            if (!in_market(entity_site, market_site, the_market)) remove_member(market_e, entity);
+        }
+    }
+    for (auto market_e : sites_around(market_sites, entity_site.position, search)) {
+        const auto& [market_site, the_market] = entities.get<site, market>(market_e);
+        const float distance = glm::length(entity_site.position - market_site.position);
+        slack = std::min(slack, static_cast<float>(std::abs(distance - the_market.radius)) - margin);
+        if (in_market(entity_site, market_site, the_market)) add_member(market_e, entity);
+    }
+    return slack;
+}
+
+void te::sim::demolish(entt::entity entity) {
+    leave_markets(entity);
+    if (auto [entity_site, print] = entities.try_get<site, footprint>(entity); entity_site && print) {
+        const auto topleft = topleft_cell(entity_site->position, *print);
+        if (grid.at(topleft) == entity) {
+            grid.clear(topleft, glm::ivec2{print->dimensions});
+        }
+    }
+    entities.destroy(entity);
+}
+
 bool te::sim::can_place(entt::entity entity, glm::vec2 centre) {
     {
         auto& print = entities.get<footprint>(entity);
-        glm::vec2 topleft = centre - print.dimensions / 2.0f;
-        for (int x = 0; x < print.dimensions.x; x++) {
-            for (int y = 0; y < print.dimensions.y; y++) {
-                if (
-                    grid.find({topleft.x + x, topleft.y + y}) != grid.end()
-                    || centre.x + x >  map_width / 2
-                    || centre.x + x < -map_width / 2
-                    || centre.y + y >  map_height / 2
-                    || centre.y + y < -map_height / 2
-                ) {
-                    return false;
-                }
-            }
+        if (!grid.is_free(topleft_cell(centre, print), glm::ivec2{print.dimensions})) {
+            return false;
         }
     }
     if (auto maybe_market = entities.try_get<market>(entity); maybe_market) {
-        auto other_markets = entities.view<site, market>();
+        const auto others = sites_around(market_sites, centre, maybe_market->radius + widest_market);
         const bool conflict = std::any_of (
-            other_markets.begin(),
-            other_markets.end(),
+            others.begin(),
+            others.end(),
             [&] (auto other) {
-                const auto& [other_site, other_market] = other_markets.get<site, market>(other);
+                const auto& [other_site, other_market] = entities.get<site, market>(other);
                 return glm::length(glm::vec2{centre - other_site.position})
                     <= (maybe_market->radius + other_market.radius);
             }
@@ -162,10 +586,110 @@ std::optional<entt::entity> te::sim::try_place(entt::entity proto, glm::vec2 cen
     if (!can_place(proto, centre)) {
         return {};
     }
-    
-    auto instantiated = entities.create(proto, entities);
+    auto instantiated = instantiate(proto, centre);
+    join_markets(instantiated);
+    return instantiated;
+}
+
+std::vector<entt::entity> te::sim::instantiate_many(entt::entity proto, const std::vector<glm::vec2>& centres) {
+    const auto print = entities.get<footprint>(proto);
+    const auto* proto_market = entities.try_get<market>(proto);
+    const double radius = proto_market ? proto_market->radius : 0.0;
+
+    // each building claims its cells as it's accepted, so that later ones in the batch see them taken
+    std::vector<entt::entity> placed;
+    std::vector<glm::vec2> placed_centres;
+    for (auto centre : centres) {
+        if (!can_place(proto, centre)) continue;
+        if (proto_market) {
+            // markets in the batch have no market yet for can_place to see
+            const bool conflict = std::any_of (
+                placed_centres.begin(),
+                placed_centres.end(),
+                [&](glm::vec2 other) { return glm::length(centre - other) <= radius * 2.0; }
+            );
+            if (conflict) continue;
+        }
+        const auto building = entities.create();
+        grid.fill(topleft_cell(centre, print), glm::ivec2{print.dimensions}, building);
+        placed.push_back(building);
+        placed_centres.push_back(centre);
+    }
+    if (placed.empty()) return placed;
+    const bool is_market = proto_market != nullptr;
+
+    clone_columns(entities, proto, placed, building_components {});
+    entities.reserve<site>(entities.size<site>() + placed.size());
+    for (std::size_t i = 0; i < placed.size(); i++) {
+        entities.assign<site>(placed[i], placed_centres[i]);
+        entities.get<named>(placed[i]).numbered = true;
+    }
+    if (is_market) {
+        std::vector<entt::entity> commons(placed.size());
+        entities.create(commons.begin(), commons.end());
+        entities.assign<trader>(commons.begin(), commons.end(), trader { 0u });
+        entities.assign<inventory>(commons.begin(), commons.end());
+        for (std::size_t i = 0; i < placed.size(); i++) {
+            entities.assign<site>(commons[i], placed_centres[i]);
+            entities.get<market>(placed[i]).commons = commons[i];
+        }
+    }
+
+    // Every building within a market's radius has a cell in the square around it, so scanning the
+    // grid there, around each market the batch could touch, finds everything that should join.
+    glm::vec2 batch_min = placed_centres.front();
+    glm::vec2 batch_max = placed_centres.front();
+    for (auto centre : placed_centres) {
+        batch_min = glm::min(batch_min, centre);
+        batch_max = glm::max(batch_max, centre);
+    }
+    std::vector<entt::entity> touched;
+    const auto widest = static_cast<float>(widest_market);
+    market_sites.each_in_rect(batch_min - widest, batch_max + widest, [&](entt::entity market_e, glm::vec2 position) {
+        const auto reach = static_cast<float>(entities.get<market>(market_e).radius);
+        if (position.x >= batch_min.x - reach && position.y >= batch_min.y - reach
+            && position.x <= batch_max.x + reach && position.y <= batch_max.y + reach) {
+            touched.push_back(market_e);
+        }
+    });
+    std::sort(touched.begin(), touched.end());
+    for (auto market_e : touched) {
+        const auto& [market_site, the_market] = entities.get<site, market>(market_e);
+        const glm::ivec2 first { glm::floor(market_site.position - static_cast<float>(the_market.radius)) };
+        const glm::ivec2 last { glm::ceil(market_site.position + static_cast<float>(the_market.radius)) };
+        for (int y = first.y; y <= last.y; y++) {
+            for (int x = first.x; x <= last.x; x++) {
+                const auto owner = grid.at({x, y});
+                if (owner && in_market(entities.get<site>(*owner), market_site, the_market)) {
+                    add_member(market_e, *owner);
+                }
+            }
+        }
+    }
+    if (is_market) {
+        // new markets also take in what has a site but isn't on the grid, such as merchants and commons
+        for (auto market_e : placed) {
+            const auto& [market_site, the_market] = entities.get<site, market>(market_e);
+            for (auto other : sites_around(sites, market_site.position, the_market.radius)) {
+                if (entities.has<ghost>(other)) continue;
+                const auto& other_site = entities.get<site>(other);
+                if (auto other_print = entities.try_get<footprint>(other); other_print && grid.at(topleft_cell(other_site.position, *other_print)) == other) {
+                    continue;
+                }
+                if (in_market(other_site, market_site, the_market)) {
+                    add_member(market_e, other);
+                }
+            }
+        }
+    }
+    return placed;
+}
+
+entt::entity te::sim::instantiate(entt::entity proto, glm::vec2 centre) {
+    auto instantiated = entities.create();
+    clone_columns(entities, proto, { instantiated }, building_components {});
     entities.assign<site>(instantiated, centre);
-    entities.replace<named>(instantiated, fmt::format("{} (#{})", entities.get<named>(instantiated).name, static_cast<unsigned>(instantiated)));
+    entities.get<named>(instantiated).numbered = true;
     
     //TODO: remove this horrible junk
     if (auto maybe_market = entities.try_get<te::market>(instantiated); maybe_market) {
@@ -177,12 +701,7 @@ std::optional<entt::entity> te::sim::try_place(entt::entity proto, glm::vec2 cen
     }
     
     auto& print = entities.get<footprint>(instantiated);
-    glm::vec2 topleft = centre - print.dimensions / 2.0f;
-    for (int x = 0; x < print.dimensions.x; x++) {
-        for (int y = 0; y < print.dimensions.y; y++) {
-            grid[{topleft.x + x, topleft.y + y}] = instantiated;
-        }
-    }
+    grid.fill(topleft_cell(centre, print), glm::ivec2{print.dimensions}, instantiated);
     return instantiated;
 }
 
@@ -190,267 +709,495 @@ glm::vec2 te::sim::snap(glm::vec2 pos, glm::vec2 print) const {
     return round(pos - print / 2.0f) + print / 2.0f;
 }
 
-void te::sim::spawn(entt::entity proto) {
+namespace {
+    // top-left cells of a footprint on the map whose centre could be within radius of around
+    std::pair<glm::ivec2, glm::ivec2> placement_bounds(glm::vec2 around, float radius, glm::vec2 dimensions, glm::ivec2 map_dims) {
+        const glm::ivec2 map_topleft = -map_dims / 2;
+        return {
+            glm::max(glm::ivec2{glm::floor(around - radius - dimensions / 2.0f)}, map_topleft),
+            glm::min(glm::ivec2{glm::ceil(around + radius - dimensions / 2.0f)}, map_topleft + map_dims - glm::ivec2{dimensions})
+        };
+    }
+}
+
+std::vector<glm::vec2> te::sim::placements(entt::entity proto, glm::vec2 around, float radius) {
     const auto print = entities.get<footprint>(proto);
-    const double min_x = -map_width / 2.0;
-    std::uniform_real_distribution select_x_pos {min_x, min_x + map_width};
-    const double min_y = -map_height / 2.0;
-    std::uniform_real_distribution select_y_pos {min_y, min_y + map_height};
-try_again:
-    const glm::vec2 topleft {
-        std::round(select_x_pos(rengine)),
-        std::round(select_y_pos(rengine))
-    };
-    const glm::vec2 centre = topleft + print.dimensions / 2.0f;
-    if (!try_place(proto, centre))
-        goto try_again;
+    const bool is_market = entities.has<market>(proto);
+    const auto [min, max] = placement_bounds(around, radius, print.dimensions, glm::ivec2{map_width, map_height});
+    std::vector<glm::vec2> found;
+    grid.each_free(glm::ivec2{print.dimensions}, min, max,
+        [&](glm::ivec2 topleft) {
+            const glm::vec2 centre = glm::vec2{topleft} + print.dimensions / 2.0f;
+            if (glm::length(centre - around) > radius) return;
+            if (is_market && !can_place(proto, centre)) return;
+            found.push_back(centre);
+        }
+    );
+    return found;
 }
 
-bool te::sim::spawn_dwelling(entt::entity market_e) {
+std::optional<glm::vec2> te::sim::sample_placement(counter_rng& rng, entt::entity proto, glm::vec2 around, float radius, int probes) {
+    const auto print = entities.get<footprint>(proto);
+    const auto [min, max] = placement_bounds(around, radius, print.dimensions, glm::ivec2{map_width, map_height});
+    if (min.x > max.x || min.y > max.y) {
+        return std::nullopt;
+    }
+    std::uniform_int_distribution select_x_pos {min.x, max.x};
+    std::uniform_int_distribution select_y_pos {min.y, max.y};
+    // cheap while the area is mostly empty
+    for (int probe = 0; probe < probes; probe++) {
+        const glm::ivec2 topleft { select_x_pos(rng), select_y_pos(rng) };
+        const glm::vec2 centre = glm::vec2{topleft} + print.dimensions / 2.0f;
+        if (glm::length(centre - around) <= radius && can_place(proto, centre)) {
+            return centre;
+        }
+    }
+    // crowded, so find out whether anywhere is left at all
+    const auto found = placements(proto, around, radius);
+    if (found.empty()) {
+        return std::nullopt;
+    }
+    std::uniform_int_distribution<std::size_t> select_found {0, found.size() - 1};
+    return found[select_found(rng)];
+}
+
+te::counter_rng te::sim::market_rng(entt::entity market_e, random_stream stream) {
+    return counter_rng { seed, static_cast<std::uint64_t>(ticks), position_key(entities.get<site>(market_e).position), stream };
+}
+
+bool te::sim::spawn_dwelling(entt::entity market_e, counter_rng& rng) {
     const auto& [market_site, market] = entities.get<site, te::market>(market_e);
-    std::uniform_real_distribution select_x_pos {
-        market_site.position.x - market.radius,
-        market_site.position.x + market.radius
-    };
-    std::uniform_real_distribution select_y_pos {
-        market_site.position.y - market.radius,
-        market_site.position.y + market.radius
-    };
     //TODO: un-hardcode this
     auto dwelling_blueprint = blueprints[2];
-    int attempts = 0;
-try_again:
-    const glm::vec2 topleft {
-        std::round(select_x_pos(rengine)),
-        std::round(select_y_pos(rengine))
-    };
-    const glm::vec2 centre = topleft + glm::vec2{1.0f, 1.0f} / 2.0f;
-    if (!try_place(dwelling_blueprint, centre)) {
-        if (attempts++ >= 5) {
-            return false;
-        } else {
-            goto try_again;
+    if (auto centre = sample_placement(rng, dwelling_blueprint, market_site.position, market.radius); centre) {
+        return try_place(dwelling_blueprint, *centre).has_value();
+    }
+    return false;
+}
+
+int te::sim::market_stock(entt::entity market_e, std::size_t commodity) {
+    return static_cast<int>(std::lround(entities.get<market>(market_e).supply[commodity]));
+}
+
+double te::sim::market_demand(entt::entity market_e, std::size_t commodity) {
+    return entities.get<market>(market_e).demand[commodity];
+}
+
+double te::sim::progress(const generator& the_generator) const {
+    if (!the_generator.due) return 1.0;
+    return glm::clamp(1.0 - (*the_generator.due - time) * the_generator.rate, 0.0, 1.0);
+}
+
+double te::sim::progress(const producer& the_producer) const {
+    if (!the_producer.producing || !the_producer.due) return 0.0;
+    return glm::clamp(1.0 - (*the_producer.due - time) * the_producer.rate, 0.0, 1.0);
+}
+
+void te::sim::tick(double dt) {
+    const auto started = std::chrono::steady_clock::now();
+    ticks++;
+    time += dt;
+    // this tick's times, added to the running totals at the end
+    phase_times times {};
+    std::optional<phase_timer> merchants_timer { std::in_place, times, tick_phase::merchants };
+    move_merchants(dt);
+    merchants_timer.reset();
+
+    tick_markets.clear();
+    tick_dts.clear();
+    auto markets = entities.view<market, site>();
+    for (auto market_e : markets) {
+        const auto& market_site = markets.get<site>(market_e);
+        auto& the_market = markets.get<market>(market_e);
+        the_market.pending += dt;
+        // markets out of focus take turns, by where they stand so that it survives a save and is
+        // the same on every platform
+        const bool due = lod.stride <= 1
+            || at_full_detail(market_site, the_market)
+            || (static_cast<std::uint64_t>(ticks) + counter_rng::mix(position_key(market_site.position))) % lod.stride == 0;
+        if (!due) {
+            lod_work.deferred++;
+            continue;
         }
+        tick_markets.push_back(market_e);
+        tick_dts.push_back(the_market.pending);
+        the_market.pending = 0.0;
+        lod_work.ticked++;
+    }
+    tick_effects.resize(tick_markets.size());
+    for (auto& effects : tick_effects) {
+        effects.family_balances.assign(families.size(), 0.0);
+        effects.times = {};
+        effects.price_change = 0.0;
+        effects.trades.clear();
+    }
+    price_change = 0.0;
+    // markets never overlap, so each one only touches its own members and can tick on its own thread
+    const std::function<void(std::size_t)> tick_one = [&](std::size_t i) {
+        tick_market(tick_markets[i], tick_dts[i], tick_effects[i]);
+    };
+    if (workers) {
+        workers->run(tick_markets.size(), tick_one);
     } else {
-        entities.get<te::market>(market_e).population++;
-        return true;
+        for (std::size_t i = 0; i < tick_markets.size(); i++) tick_one(i);
+    }
+    auto record = profile.record();
+    if (record) {
+        record->tick = ticks;
+        record->dt = dt;
+        // those that moved, rather than waited at a stop
+        record->merchants = static_cast<std::size_t>(std::count(lanes.arrived.begin(), lanes.arrived.end(), std::uint8_t{0}));
+        record->markets.clear();
+    }
+    for (std::size_t i = 0; i < tick_markets.size(); i++) {
+        settle_market(tick_markets[i], tick_effects[i]);
+        for (std::size_t phase = 0; phase < tick_phase_count; phase++) {
+            times[phase] += tick_effects[i].times[phase];
+        }
+        if (record) {
+            record->markets.push_back(market_profile { tick_markets[i], members_of(tick_markets[i]).size(), tick_effects[i].times });
+        }
+    }
+    for (std::size_t phase = 0; phase < tick_phase_count; phase++) {
+        tick_times[phase] += times[phase];
+    }
+    if (record) {
+        record->times = times;
+        record->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
     }
 }
 
-int te::sim::market_stock(entt::entity market_e, entt::entity commodity_e) {
-    const auto& market_site = entities.get<te::site>(market_e);
-    const auto& market = entities.get<te::market>(market_e);
-    int tot = 0;
-    entities.view<te::site, te::trader>().each (
-        [&](auto& site, auto& trader) {
-            if (in_market(site, market_site, market) && trader.bid[commodity_e] < 0) {
-                tot -= trader.bid[commodity_e];
-            }
+bool te::sim::at_full_detail(const site& market_site, const market& the_market) const {
+    if (lod.focus && glm::length(market_site.position - *lod.focus) <= lod.radius + the_market.radius) return true;
+    return lod.inspected && glm::length(market_site.position - *lod.inspected) <= the_market.radius;
+}
+
+te::economy_metrics te::sim::measure() {
+    economy_metrics metrics {};
+    metrics.time = time;
+    metrics.ticks = ticks;
+    metrics.commodities = commodities.size();
+    for (const auto& family : families) {
+        metrics.family_balances.push_back(family.balance);
+    }
+    auto markets = entities.view<market, site>();
+    for (auto market_e : markets) {
+        const auto& the_market = markets.get<market>(market_e);
+        metrics.markets++;
+        metrics.population += the_market.population;
+        metrics.mean_growth_rate += the_market.growth_rate;
+        for (std::size_t commodity = 0; commodity < commodities.size(); commodity++) {
+            metrics.mean_prices[commodity] += the_market.prices[commodity];
         }
-    );
-    return tot;
+    }
+    if (metrics.markets > 0) {
+        metrics.mean_growth_rate /= metrics.markets;
+        for (auto& mean_price : metrics.mean_prices) mean_price /= metrics.markets;
+    }
+    return metrics;
 }
 
-void te::sim::tick(double dt) {
-    auto merchants = entities.view<merchant, inventory, site>();
-    for (auto merchant_e : merchants) {
-        auto& merchant = merchants.get<te::merchant>(merchant_e);
-        if (!merchant.route) continue;
-        auto& merchant_inventory = merchants.get<te::inventory>(merchant_e);
-        auto& merchant_site = merchants.get<te::site>(merchant_e);
-        
-        std::size_t dest_stop_ix = (merchant.last_stop + 1) % merchant.route->stops.size();
-        stop& dest_stop = merchant.route->stops[dest_stop_ix];
-        auto dest = entities.get<site>(dest_stop.where);
-        auto course = dest.position - merchant_site.position;
-        auto distance = glm::length(course);
-        // is the merchant at his desired market?
-        if (distance <= 1.0f) {
-            if (merchant.trading) {
-                if (merchant_inventory.stock == dest_stop.leave_with) {
-                    // stop trading
-                    merchant.trading = false;
-                    // start heading to next market
-                    merchant.last_stop = dest_stop_ix;
-                } else {
-                    // do nothing - wait for trades to finish
-                }
+long te::sim::advance(double game_seconds, double step, const advance_options& options) {
+    if (step <= 0.0) {
+        throw std::runtime_error("Can't advance by steps of no time");
+    }
+    const auto started = std::chrono::steady_clock::now();
+    const double max_step = std::max(step, options.max_step);
+    double current_step = step;
+    double elapsed = 0.0;
+    double next_report = options.report_interval;
+    long taken = 0;
+    while (elapsed < game_seconds) {
+        const double dt = std::min(current_step, game_seconds - elapsed);
+        tick(dt);
+        taken++;
+        elapsed += dt;
+        if (options.on_tick) options.on_tick(dt);
+        // double while prices are barely moving, halve back as soon as they move too much
+        if (price_change < options.tolerance / 2.0) {
+            current_step = std::min(current_step * 2.0, max_step);
+        } else if (price_change > options.tolerance) {
+            current_step = std::max(current_step / 2.0, step);
+        }
+        if (options.report && (elapsed >= game_seconds || (options.report_interval > 0.0 && elapsed >= next_report))) {
+            while (options.report_interval > 0.0 && next_report <= elapsed) next_report += options.report_interval;
+            const std::chrono::duration<double> real_seconds = std::chrono::steady_clock::now() - started;
+            options.report(advance_report { elapsed, game_seconds, taken, dt, real_seconds.count() });
+        }
+    }
+    return taken;
+}
+
+void te::sim::lay_out_lanes() {
+    lanes.clear();
+    auto merchants = entities.view<merchant>();
+    const entt::entity* merchant_entities = merchants.data();
+    for (std::size_t i = 0; i < merchants.size(); i++) {
+        const auto merchant_e = merchant_entities[i];
+        const auto& the_merchant = merchants.get(merchant_e);
+        // merchants without anywhere to go sit at their destination, so they never move
+        glm::vec2 position {};
+        if (auto merchant_site = entities.try_get<site>(merchant_e); merchant_site) {
+            position = merchant_site->position;
+        }
+        glm::vec2 destination = position;
+        if (the_merchant.route && !the_merchant.route->stops.empty() && entities.has<site, inventory>(merchant_e)) {
+            const auto& stops = the_merchant.route->stops;
+            destination = entities.get<site>(stops[(the_merchant.last_stop + 1) % stops.size()].where).position;
+        }
+        lanes.push_back(merchant_e, position.x, position.y, destination.x, destination.y, the_merchant.speed);
+    }
+}
+
+void te::sim::move_merchants(double dt) {
+    auto merchants = entities.view<merchant>();
+    if (!lanes.matches(merchants.data(), merchants.size())) {
+        lay_out_lanes();
+    }
+    lanes.advance(static_cast<float>(dt));
+
+    // only merchants who have arrived somewhere need anything more than their site updating
+    for (std::size_t i = 0; i < lanes.size(); i++) {
+        const auto merchant_e = lanes.merchants[i];
+        if (!lanes.arrived[i]) {
+            entities.replace<site>(merchant_e, glm::vec2{lanes.x[i], lanes.y[i]});
+            if (lanes.slack[i] <= 0.0f) {
+                lanes.slack[i] = update_markets(merchant_e);
+            }
+            continue;
+        }
+        auto& the_merchant = merchants.get(merchant_e);
+        if (!the_merchant.route || the_merchant.route->stops.empty() || !entities.has<site, inventory>(merchant_e)) continue;
+        const auto& stops = the_merchant.route->stops;
+        const std::size_t dest_stop_ix = (the_merchant.last_stop + 1) % stops.size();
+        const stop& dest_stop = stops[dest_stop_ix];
+        const auto& merchant_inventory = entities.get<inventory>(merchant_e);
+        if (the_merchant.trading) {
+            if (merchant_inventory.stock == dest_stop.leave_with) {
+                // stop trading
+                the_merchant.trading = false;
+                // start heading to next market
+                the_merchant.last_stop = dest_stop_ix;
+                const auto next = entities.get<site>(stops[(dest_stop_ix + 1) % stops.size()].where).position;
+                lanes.destination_x[i] = next.x;
+                lanes.destination_y[i] = next.y;
+                lanes.speed[i] = the_merchant.speed;
             } else {
-                merchant.trading = true;
-                auto& bids = entities.get<trader>(merchant_e).bid;
-                    
-                for (auto [commodity_e, count] : dest_stop.leave_with) {
-                    bids[commodity_e] = count - merchant_inventory.stock[commodity_e];
-                }
+                // do nothing - wait for trades to finish
             }
         } else {
-            // move him a bit closer
-            merchant_site.position += glm::normalize(course) * static_cast<float>(dt);
-        }
-    }
-    entities.view<market, site>().each (
-        [&](entt::entity market_e, auto& market, auto& market_site) {
-            // advance generators
-            entities.view<generator, inventory, trader, site>().each (
-                [&](auto& generator, auto& inventory, auto& trader, auto& generator_site) {
-                    if (in_market(generator_site, market_site, market)) {
-                        if (generator.progress < 1.0) {
-                            generator.progress += generator.rate * dt;
-                        } else if (generator.progress >= 1.0 && inventory.stock[generator.output] < 10) {
-                            inventory.stock[generator.output]++;
-                            trader.bid[generator.output] -= 1.0;
-                            generator.progress -= 1.0;
-                        }
-                    }
+            the_merchant.trading = true;
+            for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+                set_bid(merchant_e, commodity, dest_stop.leave_with[commodity] - merchant_inventory.stock[commodity]);
+            }
+        }
+    }
+}
+
+void te::sim::tick_market(entt::entity market_e, double dt, market_effects& effects) {
+    auto& market = entities.get<te::market>(market_e);
+
+    // entries are dropped if the building has left the market or its plans have changed since
+    auto still_due = [&](entt::entity building_e, const std::optional<double>& building_due, double due) {
+        return building_due == due && is_member(market_e, building_e);
+    };
+
+    // finish generators' units
+    {
+        phase_timer timer { effects.times, tick_phase::generators };
+        market.generator_schedule.run_due (
+            time,
+            [&](entt::entity member_e, double due) {
+                if (!entities.valid(member_e) || !entities.has<generator, inventory, trader>(member_e)) return;
+                auto [generator, inventory, trader] = entities.get<te::generator, te::inventory, te::trader>(member_e);
+                if (!still_due(member_e, generator.due, due)) return;
+                if (inventory.stock[generator.output] < generator_capacity) {
+                    inventory.stock[generator.output]++;
+                    market.set_bid(member_e, trader, generator.output, trader.bid[generator.output] - 1.0);
+                    generator.due = due + 1.0 / generator.rate;
+                    market.generator_schedule.schedule(member_e, *generator.due);
+                } else {
+                    // full until some is sold
+                    generator.due.reset();
                 }
-            );
+            }
+        );
+    }
 
-            // advance producers
-            entities.view<producer, inventory, site, trader>().each (
-                [&](auto& producer, auto& inventory, auto& site, auto& trader) {
-                    if (in_market(site, market_site, market)) {
-                        if (producer.producing) {
-                            producer.progress += producer.rate * dt;
-                            if (producer.progress > 1.0) {
-                                for (auto [commodity, produced] : producer.outputs) {
-                                    inventory.stock[commodity] += produced;
-                                    trader.bid[commodity] -= produced;
-                                }
-                                producer.progress = 0.0;
-                                producer.producing = false;
-                            }
-                        } else {
-                            bool enough = std::all_of (
-                                producer.inputs.begin(),
-                                producer.inputs.end(),
-                                [&](auto pair) {
-                                    auto [commodity, needed] = pair;
-                                    return inventory.stock[commodity] >= needed;
-                                }
-                            );
-                            if (enough) {
-                                for (auto [commodity, needed] : producer.inputs) {
-                                    inventory.stock[commodity] -= needed;
-                                }
-                                producer.producing = true;
-                            } else {
-                                for (auto [commodity, needed] : producer.inputs) {
-                                    trader.bid[commodity] = std::max(0.0, needed - inventory.stock[commodity]);
-                                }
-                            }
-                        }
+    // finish producers' batches and start new ones
+    {
+        phase_timer timer { effects.times, tick_phase::producers };
+        market.producer_schedule.run_due (
+            time,
+            [&](entt::entity member_e, double due) {
+                if (!entities.valid(member_e) || !entities.has<producer, inventory, trader>(member_e)) return;
+                auto [producer, inventory, trader] = entities.get<te::producer, te::inventory, te::trader>(member_e);
+                if (!still_due(member_e, producer.due, due)) return;
+                producer.due.reset();
+                if (producer.producing) {
+                    for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+                        inventory.stock[commodity] += producer.outputs[commodity];
+                        market.set_bid(member_e, trader, commodity, trader.bid[commodity] - producer.outputs[commodity]);
                     }
+                    producer.producing = false;
                 }
-            );
-           
-            // demanders cause the market trader to demand more
-            entities.view<demander, site>().each (
-                [&](auto& demander, auto& demander_site) {
-                    if (in_market(demander_site, market_site, market)) {
-                        for (auto [commodity_e, demand_rate] : demander.rate) {
-                            entities.get<trader>(market.commons).bid[commodity_e] += demand_rate * dt;
-                        }
-                    }
+                bool enough = true;
+                for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+                    enough &= inventory.stock[commodity] >= producer.inputs[commodity];
                 }
-            );
-
-            for (auto commodity_e : commodities) {
-                //TODO: sort traders here
-                //TODO: make this not O(N^2)
-                //TODO: somehow deal with dwellings...
-                entities.view<inventory, site, trader>().each (
-                    [&](entt::entity trader_a_e, auto& trader_a_inventory, auto& trader_a_site, auto& trader_a) {
-                        entities.view<inventory, site, trader>().each (
-                            [&](entt::entity trader_b_e, auto& trader_b_inventory, auto& trader_b_site, auto& trader_b) {
-                                if (in_market(trader_a_site, market_site, market) && in_market(trader_b_site, market_site, market)) {
-                                    auto& a_bid = trader_a.bid[commodity_e];
-                                    auto& b_bid = trader_b.bid[commodity_e];
-                                    if (a_bid > 0.0 && b_bid < 0.0) {
-                                        auto movement = static_cast<int>(std::min(a_bid, std::abs(b_bid)));
-                                        auto& a_stock = trader_a_inventory.stock[commodity_e];
-                                        auto& b_stock = trader_b_inventory.stock[commodity_e];
-                                        if (movement != 0) {
-                                            if (b_stock >= movement) {
-                                                auto price = market.prices[commodity_e];
-                                                a_bid -= movement;
-                                                a_stock += movement;
-                                                trader_a.balance -= price;
-                                                families[trader_a.family_ix].balance -= price;
-                                                b_bid += movement;
-                                                b_stock -= movement;
-                                                trader_b.balance += price;
-                                                families[trader_b.family_ix].balance += price;
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        );
+                if (enough) {
+                    for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+                        inventory.stock[commodity] -= producer.inputs[commodity];
                     }
-                );
-            }
-            
-            // market demand is sum of all trader demands
-            market.demand = {};
-            entities.view<trader, site>().each (
-                [&](auto& trader, auto& trader_site) {
-                    if (in_market(trader_site, market_site, market)) {
-                        for (auto [commodity, bid] : trader.bid) {
-                            //TODO: make bids only in increments
-                            market.demand[commodity] += std::max(0.0, std::floor(bid * (1.0 / 0.01)) / (1 / 0.01));
+                    producer.producing = true;
+                    producer.due = due + 1.0 / producer.rate;
+                    market.producer_schedule.schedule(member_e, *producer.due);
+                } else {
+                    // idle until some inputs are bought
+                    for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+                        if (producer.inputs[commodity] > 0.0) {
+                            market.set_bid(member_e, trader, commodity, std::max(0.0, producer.inputs[commodity] - inventory.stock[commodity]));
                         }
                     }
                 }
-            );
-           
-            // calculate market prices
-            for (auto& [commodity, price] : market.prices) {
-                const double base_price = entities.get<te::price>(commodity).price;
-                const double demand = market.demand[commodity];
-                const int stock = market_stock(market_e, commodity);
-                const double disparity = static_cast<int>(demand) - stock;
-                price = glm::clamp (
-                    price + disparity * 0.0002,
-                    base_price * 0.5,
-                    base_price * 1.5
-                );
             }
-            
-            // calculate market population
-            market.population = 0;
-            auto dwellings = entities.view<dweller, site>();
-            for (auto entity : dwellings) {
-                auto& dwelling_site = dwellings.get<te::site>(entity);
-                if (in_market(dwelling_site, market_site, market)) {
-                    market.population++;
-                }
-            };
+        );
+    }
 
-            // calculate market growth rate
-            market.growth_rate = 0.0;
-            for (auto commodity : commodities) {
-                auto base_price = entities.get<price>(commodity).price;
-                market.growth_rate += ((base_price - market.prices[commodity]) / base_price) * 0.1;
+    // demanders cause the market trader to demand more
+    {
+        phase_timer timer { effects.times, tick_phase::demanders };
+        auto& commons_trader = entities.get<trader>(market.commons);
+        for (std::size_t commodity = 0; commodity < max_commodities; commodity++) {
+            if (market.demand_rate[commodity] != 0.0) {
+                market.set_bid(market.commons, commons_trader, commodity, commons_trader.bid[commodity] + market.demand_rate[commodity] * dt);
             }
-            market.growth_rate = glm::clamp(market.growth_rate, -1.0, 1.0);
-
-            // grow
-            market.growth += market.growth_rate * dt;
+        }
+    }
 
-            // create/destroy dwellings
-            while (static_cast<int>(market.growth) > 0 && spawn_dwelling(market_e)) {
-                market.growth -= 1.0;
+    // match bids and asks
+    {
+        phase_timer timer { effects.times, tick_phase::matching };
+        auto traders = entities.group<trader, inventory>();
+        for (std::size_t commodity = 0; commodity < commodities.size(); commodity++) {
+            //TODO: somehow deal with dwellings...
+            // Only awake traders are visited. The book breaks ties by entity, so the order they
+            // woke in doesn't matter, and orders that can't trade never would have matched.
+            auto& awake = market.awake[commodity];
+            std::sort(awake.begin(), awake.end());
+            awake.erase(std::unique(awake.begin(), awake.end()), awake.end());
+            awake.erase (
+                std::remove_if (
+                    awake.begin(),
+                    awake.end(),
+                    [&](entt::entity trader_e) {
+                        if (!entities.valid(trader_e) || !traders.contains(trader_e) || !is_member(market_e, trader_e)) return true;
+                        auto [the_trader, the_inventory] = traders.get<trader, inventory>(trader_e);
+                        return !can_trade(the_trader.bid[commodity], the_inventory.stock[commodity]);
+                    }
+                ),
+                awake.end()
+            );
+            market.orders.clear();
+            for (auto trader_e : awake) {
+                market.orders.add(trader_e, traders.get<trader>(trader_e).bid[commodity]);
             }
-            while (static_cast<int>(market.growth) < 0) {
-                market.growth += 1.0;
-                for (auto dwelling : entities.view<dweller, site>()) {
-                    auto& dwelling_site = entities.get<site>(dwelling);
-                    if (in_market(dwelling_site, market_site, market)) {
-                        entities.destroy(dwelling);
-                        break;
+            const auto price = market.prices[commodity];
+            market.orders.match (
+                [&](entt::entity buyer_e, entt::entity seller_e, int movement) {
+                    auto [buyer, buyer_inventory] = traders.get<trader, inventory>(buyer_e);
+                    auto [seller, seller_inventory] = traders.get<trader, inventory>(seller_e);
+                    auto& seller_stock = seller_inventory.stock[commodity];
+                    if (seller_stock < movement) {
+                        return 0;
                     }
+                    market.set_bid(buyer_e, buyer, commodity, buyer.bid[commodity] - movement);
+                    buyer_inventory.stock[commodity] += movement;
+                    buyer.balance -= price;
+                    effects.family_balances[buyer.family_ix] -= price;
+                    market.set_bid(seller_e, seller, commodity, seller.bid[commodity] + movement);
+                    seller_stock -= movement;
+                    seller.balance += price;
+                    effects.family_balances[seller.family_ix] += price;
+                    if (journal) {
+                        effects.trades.push_back (
+                            trade { ticks, market_e, static_cast<std::uint32_t>(commodity), buyer_e, seller_e, movement, price }
+                        );
+                    }
+                    wake(market, buyer_e);
+                    wake(market, seller_e);
+                    return movement;
                 }
-            }
+            );
         }
-    );
+    }
+
+    // calculate market prices
+    {
+        phase_timer timer { effects.times, tick_phase::pricing };
+        for (std::size_t commodity = 0; commodity < commodities.size(); commodity++) {
+            const double base_price = entities.get<te::price>(commodities[commodity]).price;
+            const double demand = market.demand[commodity];
+            const int stock = static_cast<int>(std::lround(market.supply[commodity]));
+            const double disparity = static_cast<int>(demand) - stock;
+            auto& price = market.prices[commodity];
+            const double old_price = price;
+            // per game second, so that longer ticks move prices just as far
+            price = glm::clamp (
+                price + disparity * 0.0008 * dt,
+                base_price * 0.5,
+                base_price * 1.5
+            );
+            effects.price_change = std::max(effects.price_change, std::abs(price - old_price) / base_price);
+        }
+    }
+
+    // calculate market growth rate
+    {
+        phase_timer timer { effects.times, tick_phase::growth };
+        market.growth_rate = 0.0;
+        for (std::size_t commodity = 0; commodity < commodities.size(); commodity++) {
+            auto base_price = entities.get<price>(commodities[commodity]).price;
+            market.growth_rate += ((base_price - market.prices[commodity]) / base_price) * 0.1;
+        }
+        market.growth_rate = glm::clamp(market.growth_rate, -1.0, 1.0);
+
+        // grow
+        market.growth += market.growth_rate * dt;
+    }
+}
+
+void te::sim::settle_market(entt::entity market_e, market_effects& effects) {
+    for (std::size_t family_ix = 0; family_ix < families.size(); family_ix++) {
+        families[family_ix].balance += effects.family_balances[family_ix];
+    }
+    price_change = std::max(price_change, effects.price_change);
+    if (journal) {
+        for (const auto& the_trade : effects.trades) {
+            journal->append(the_trade);
+        }
+    }
+    phase_timer timer { effects.times, tick_phase::dwellings };
+    settle_dwellings(market_e);
+}
+
+void te::sim::settle_dwellings(entt::entity market_e) {
+    auto& market = entities.get<te::market>(market_e);
+    const auto& members = members_of(market_e);
+    // create/destroy dwellings
+    auto rng = market_rng(market_e, random_stream::dwellings);
+    while (static_cast<int>(market.growth) > 0 && spawn_dwelling(market_e, rng)) {
+        market.growth -= 1.0;
+    }
+    while (static_cast<int>(market.growth) < 0) {
+        market.growth += 1.0;
+        auto dwelling_it = std::find_if (
+            members.begin(),
+            members.end(),
+            [&](auto member_e) { return entities.has<dweller>(member_e); }
+        );
+        if (dwelling_it != members.end()) {
+            demolish(*dwelling_it);
+        }
+    }
 }
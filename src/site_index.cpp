@@ -0,0 +1,92 @@
+#include <te/site_index.hpp>
+#include <algorithm>
+#include <cmath>
+
+te::site_index::site_index(int width, int height, float cell_size) :
+    cell_size { cell_size },
+    origin { -glm::vec2{width / 2, height / 2} },
+    cell_counts {
+        std::max(1, static_cast<int>(std::ceil(width / cell_size))),
+        std::max(1, static_cast<int>(std::ceil(height / cell_size)))
+    },
+    cells(static_cast<std::size_t>(cell_counts.x) * cell_counts.y)
+{
+}
+
+std::size_t te::site_index::index_of(entt::entity entity) {
+    using traits = entt::entt_traits<std::underlying_type_t<entt::entity>>;
+    return static_cast<std::underlying_type_t<entt::entity>>(entity) & traits::entity_mask;
+}
+
+glm::ivec2 te::site_index::cell_at(glm::vec2 position) const {
+    const glm::vec2 cell = glm::floor((position - origin) / cell_size);
+    // clamped as floats first, so that far-off positions can't overflow an int
+    return glm::ivec2 {
+        static_cast<int>(std::clamp(cell.x, 0.0f, static_cast<float>(cell_counts.x - 1))),
+        static_cast<int>(std::clamp(cell.y, 0.0f, static_cast<float>(cell_counts.y - 1)))
+    };
+}
+
+void te::site_index::unlink(place at) {
+    auto& cell = cells[at.cell];
+    if (at.slot + 1 != cell.size()) {
+        cell[at.slot] = cell.back();
+        places[index_of(cell[at.slot].entity)].slot = at.slot;
+    }
+    cell.pop_back();
+}
+
+void te::site_index::insert(entt::entity entity, glm::vec2 position) {
+    const auto ix = index_of(entity);
+    if (ix >= places.size()) {
+        places.resize(std::max(ix + 1, places.size() * 2), place { nowhere, nowhere });
+    }
+    if (places[ix].cell != nowhere) {
+        move(entity, position);
+        return;
+    }
+    const auto cell = cell_ix(cell_at(position));
+    places[ix] = place { cell, static_cast<std::uint32_t>(cells[cell].size()) };
+    cells[cell].push_back(entry { entity, position });
+    count++;
+}
+
+void te::site_index::move(entt::entity entity, glm::vec2 position) {
+    const auto ix = index_of(entity);
+    if (ix >= places.size() || places[ix].cell == nowhere) {
+        insert(entity, position);
+        return;
+    }
+    const auto cell = cell_ix(cell_at(position));
+    auto& at = places[ix];
+    if (cell == at.cell) {
+        cells[cell][at.slot].position = position;
+        return;
+    }
+    unlink(at);
+    at = place { cell, static_cast<std::uint32_t>(cells[cell].size()) };
+    cells[cell].push_back(entry { entity, position });
+}
+
+void te::site_index::erase(entt::entity entity) {
+    const auto ix = index_of(entity);
+    if (ix >= places.size() || places[ix].cell == nowhere) return;
+    unlink(places[ix]);
+    places[ix] = place { nowhere, nowhere };
+    count--;
+}
+
+bool te::site_index::contains(entt::entity entity) const {
+    const auto ix = index_of(entity);
+    return ix < places.size() && places[ix].cell != nowhere;
+}
+
+std::size_t te::site_index::size() const {
+    return count;
+}
+
+void te::site_index::clear() {
+    for (auto& cell : cells) cell.clear();
+    places.clear();
+    count = 0;
+}
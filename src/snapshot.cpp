@@ -0,0 +1,720 @@
+#include <te/snapshot.hpp>
+#include <te/render_components.hpp>
+#include <fmt/format.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char snapshot_magic[8] = {'t', 'e', 's', 'n', 'a', 'p', '\0', '\0'};
+    // columns start on this boundary, which suits every component type
+    constexpr std::size_t column_alignment = 32;
+
+    struct header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t seed;
+        std::int32_t map_width;
+        std::int32_t map_height;
+        std::int64_t ticks;
+        double time;
+    };
+
+    // written before each part of the snapshot, to catch a reader getting out of step
+    enum class section : std::uint32_t {
+        entities = 1,
+        strings,
+        named,
+        price,
+        footprint,
+        site,
+        ghost,
+        dweller,
+        demander,
+        trader,
+        generator,
+        producer,
+        inventory,
+        market,
+        merchant,
+        render_mesh,
+        render_tex,
+        pickable,
+        families,
+        commodities,
+        blueprints,
+        routes,
+        lod,
+        grid,
+        membership
+    };
+
+    class writer {
+        std::vector<char> bytes;
+    public:
+        void put_bytes(const void* data, std::size_t size) {
+            const char* begin = static_cast<const char*>(data);
+            bytes.insert(bytes.end(), begin, begin + size);
+        }
+        template<typename T>
+        void put(const T& value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            put_bytes(&value, sizeof(T));
+        }
+        void put_string(const std::string& str) {
+            put<std::uint64_t>(str.size());
+            put_bytes(str.data(), str.size());
+        }
+        void align() {
+            bytes.resize((bytes.size() + column_alignment - 1) / column_alignment * column_alignment, '\0');
+        }
+        template<typename T>
+        void put_column(const T* values, std::size_t count) {
+            static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= column_alignment);
+            align();
+            put_bytes(values, count * sizeof(T));
+        }
+        const std::vector<char>& contents() const {
+            return bytes;
+        }
+    };
+
+    class reader {
+        const char* begin;
+        const char* at;
+        const char* end;
+    public:
+        reader(const char* begin, std::size_t size) : begin { begin }, at { begin }, end { begin + size } {
+        }
+        const char* take(std::size_t size) {
+            if (static_cast<std::size_t>(end - at) < size) {
+                throw te::snapshot_error("Snapshot is truncated");
+            }
+            const char* taken = at;
+            at += size;
+            return taken;
+        }
+        template<typename T>
+        T get() {
+            static_assert(std::is_trivially_copyable_v<T>);
+            T value;
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        }
+        std::string get_string() {
+            const auto size = get<std::uint64_t>();
+            return std::string(take(size), size);
+        }
+        void expect(section part) {
+            if (get<section>() != part) {
+                throw te::snapshot_error(fmt::format("Snapshot is corrupt: expected section {}", static_cast<std::uint32_t>(part)));
+            }
+        }
+        void align() {
+            const std::size_t offset = at - begin;
+            take((offset + column_alignment - 1) / column_alignment * column_alignment - offset);
+        }
+        // columns are aligned relative to the start of the file, which is mapped on a page boundary
+        template<typename T>
+        const T* get_column(std::size_t count) {
+            static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= column_alignment);
+            align();
+            return reinterpret_cast<const T*>(take(count * sizeof(T)));
+        }
+    };
+
+    class mapped_file {
+        const char* contents = nullptr;
+        std::size_t length = 0;
+    public:
+        explicit mapped_file(const std::string& filename) {
+            const int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw te::snapshot_error(fmt::format("Couldn't open {}: {}", filename, std::strerror(errno)));
+            }
+            struct stat info;
+            if (::fstat(fd, &info) != 0) {
+                ::close(fd);
+                throw te::snapshot_error(fmt::format("Couldn't stat {}: {}", filename, std::strerror(errno)));
+            }
+            length = static_cast<std::size_t>(info.st_size);
+            if (length > 0) {
+                void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+                if (mapped == MAP_FAILED) {
+                    throw te::snapshot_error(fmt::format("Couldn't map {}: {}", filename, std::strerror(errno)));
+                }
+                ::madvise(mapped, length, MADV_SEQUENTIAL);
+                contents = static_cast<const char*>(mapped);
+            } else {
+                ::close(fd);
+            }
+        }
+        mapped_file(const mapped_file&) = delete;
+        ~mapped_file() {
+            if (contents) ::munmap(const_cast<char*>(contents), length);
+        }
+        const char* data() const { return contents; }
+        std::size_t size() const { return length; }
+    };
+
+    using entity_traits = entt::entt_traits<std::underlying_type_t<entt::entity>>;
+
+    std::size_t slot_of(entt::entity entity) {
+        return static_cast<std::size_t>(static_cast<entity_traits::entity_type>(entity) & entity_traits::entity_mask);
+    }
+
+    entity_traits::entity_type version_of(entt::entity entity) {
+        return (static_cast<entity_traits::entity_type>(entity) >> entity_traits::entity_shift) & entity_traits::version_mask;
+    }
+
+    // the registry's destroyed entities, the next to be reused first, as they'll be reused
+    std::vector<entt::entity> destroyed_entities(const entt::registry& registry) {
+        std::vector<entt::entity> destroyed;
+        bool counted = false;
+        auto archive = [&](auto value) {
+            // the count comes first
+            if (counted) destroyed.push_back(static_cast<entt::entity>(value));
+            counted = true;
+        };
+        registry.snapshot().destroyed(archive);
+        return destroyed;
+    }
+
+    // Entities are loaded with the identifiers they were saved with, and the registry's destroyed
+    // entities are put back in the same order, so that entities created after a load get the
+    // same identifiers as they would have without it. Ties broken by entity and the numbers shown
+    // after names come out the same either way.
+    class entity_map {
+        const entt::registry& registry;
+    public:
+        entity_map(const entt::entity* alive, std::size_t alive_count, const entt::entity* destroyed, std::size_t destroyed_count, entt::registry& into) :
+            registry { into }
+        {
+            // every slot the saved registry had, as it was
+            std::vector<entt::entity> wanted(alive_count + destroyed_count, entt::null);
+            auto want = [&](entt::entity entity) {
+                const auto slot = slot_of(entity);
+                if (slot >= wanted.size() || wanted[slot] != entt::null) {
+                    throw te::snapshot_error("Snapshot is corrupt: entities don't fit together");
+                }
+                wanted[slot] = entity;
+            };
+            std::for_each(alive, alive + alive_count, want);
+            std::for_each(destroyed, destroyed + destroyed_count, want);
+
+            // An empty registry hands out slots in order, and a slot destroyed and created again
+            // comes back at the next version, so every entity is first brought to its saved version,
+            // or the one before for those to be destroyed.
+            std::vector<entt::entity> created(wanted.size());
+            into.create(created.begin(), created.end());
+            for (std::size_t slot = 0; slot < created.size(); slot++) {
+                if (slot_of(created[slot]) != slot) {
+                    throw te::snapshot_error("Snapshots can only be loaded into an empty registry");
+                }
+                const bool is_destroyed = !std::binary_search(alive, alive + alive_count, wanted[slot]);
+                const auto target = (version_of(wanted[slot]) + (is_destroyed ? entity_traits::version_mask : 0)) & entity_traits::version_mask;
+                for (entity_traits::entity_type version = 0; version < target; version++) {
+                    into.destroy(created[slot]);
+                    created[slot] = into.create();
+                }
+            }
+            // the first saved is the next to be reused, so it's destroyed last
+            for (std::size_t i = destroyed_count; i-- > 0;) {
+                into.destroy(created[slot_of(destroyed[i])]);
+            }
+        }
+        entt::entity operator()(entt::entity entity) const {
+            if (entity == entt::null) return entity;
+            if (!registry.valid(entity)) {
+                throw te::snapshot_error("Snapshot is corrupt: reference to a missing entity");
+            }
+            return entity;
+        }
+    };
+
+    // the parts of a market which aren't derived from its members
+    struct market_record {
+        te::per_commodity<double> prices;
+        entt::entity commons;
+        double radius;
+        double growth_rate;
+        double growth;
+        double pending;
+    };
+
+    struct lod_record {
+        std::uint8_t has_focus;
+        std::uint8_t has_inspected;
+        std::uint32_t stride;
+        float radius;
+        glm::vec2 focus;
+        glm::vec2 inspected;
+    };
+
+    template<typename Component>
+    void fix_references(Component&, const entity_map&) {
+    }
+
+    void fix_references(te::ghost& the_ghost, const entity_map& remap) {
+        the_ghost.proto = remap(the_ghost.proto);
+    }
+
+    template<typename Component>
+    void save_column(writer& out, entt::registry& registry, section part) {
+        static_assert(std::is_trivially_copyable_v<Component>);
+        auto view = registry.view<Component>();
+        out.put(part);
+        out.put<std::uint64_t>(view.size());
+        out.put_column(view.data(), view.size());
+        if constexpr (!std::is_empty_v<Component>) {
+            out.put_column(view.raw(), view.size());
+        }
+    }
+
+    template<typename Component>
+    void load_column(reader& in, entt::registry& registry, const entity_map& remap, section part) {
+        in.expect(part);
+        const auto count = in.get<std::uint64_t>();
+        const auto* owners = in.get_column<entt::entity>(count);
+        registry.reserve<Component>(count);
+        if constexpr (std::is_empty_v<Component>) {
+            // identifiers are loaded as they were saved, so the column can go in as it is
+            std::for_each(owners, owners + count, remap);
+            registry.assign<Component>(owners, owners + count);
+        } else {
+            const auto* components = in.get_column<Component>(count);
+            for (std::size_t i = 0; i < count; i++) {
+                Component component = components[i];
+                fix_references(component, remap);
+                registry.assign<Component>(remap(owners[i]), component);
+            }
+        }
+    }
+
+    // Interned strings are saved once each, in a table of those the snapshot uses, and components
+    // refer to them by their place in it, as handles only mean anything to the process that made them.
+    class string_table {
+        std::unordered_map<te::string_id, std::uint32_t> places;
+    public:
+        std::vector<te::string_id> saved;
+
+        template<typename Component>
+        void add_all(entt::registry& registry, te::string_id Component::* member) {
+            registry.view<Component>().each([&](const Component& component) {
+                if (places.emplace(component.*member, static_cast<std::uint32_t>(saved.size())).second) {
+                    saved.push_back(component.*member);
+                }
+            });
+        }
+        std::uint32_t place(te::string_id id) const {
+            return places.at(id);
+        }
+    };
+
+    // strings are written end to end, after a column of where each one ends
+    void save_string_table(writer& out, const string_table& table) {
+        std::vector<std::uint64_t> ends;
+        std::string joined;
+        for (auto id : table.saved) {
+            joined += te::str(id);
+            ends.push_back(joined.size());
+        }
+        out.put(section::strings);
+        out.put<std::uint64_t>(ends.size());
+        out.put_column(ends.data(), ends.size());
+        out.put<std::uint64_t>(joined.size());
+        out.put_column(joined.data(), joined.size());
+    }
+
+    // the strings of a table interned again, by place
+    std::vector<te::string_id> load_string_table(reader& in) {
+        in.expect(section::strings);
+        const auto count = in.get<std::uint64_t>();
+        const auto* ends = in.get_column<std::uint64_t>(count);
+        const auto joined_size = in.get<std::uint64_t>();
+        const auto* joined = in.get_column<char>(joined_size);
+        std::vector<te::string_id> ids;
+        ids.reserve(count);
+        std::uint64_t begin = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            if (ends[i] < begin || ends[i] > joined_size) {
+                throw te::snapshot_error("Snapshot is corrupt: bad string offsets");
+            }
+            ids.push_back(te::intern(std::string_view(joined + begin, ends[i] - begin)));
+            begin = ends[i];
+        }
+        return ids;
+    }
+
+    template<typename Component>
+    void save_interned(writer& out, entt::registry& registry, section part, const string_table& table, te::string_id Component::* member) {
+        auto view = registry.view<Component>();
+        const entt::entity* owners = view.data();
+        std::vector<std::uint32_t> places;
+        places.reserve(view.size());
+        for (std::size_t i = 0; i < view.size(); i++) {
+            places.push_back(table.place(view.get(owners[i]).*member));
+        }
+        out.put(part);
+        out.put<std::uint64_t>(view.size());
+        out.put_column(owners, view.size());
+        out.put_column(places.data(), places.size());
+    }
+
+    // returns the saved owners, in the order they were assigned
+    template<typename Component>
+    std::vector<entt::entity> load_interned(reader& in, entt::registry& registry, const entity_map& remap, section part, const std::vector<te::string_id>& table, te::string_id Component::* member) {
+        in.expect(part);
+        const auto count = in.get<std::uint64_t>();
+        const auto* owners = in.get_column<entt::entity>(count);
+        const auto* places = in.get_column<std::uint32_t>(count);
+        registry.reserve<Component>(count);
+        std::vector<entt::entity> assigned;
+        assigned.reserve(count);
+        for (std::size_t i = 0; i < count; i++) {
+            if (places[i] >= table.size()) {
+                throw te::snapshot_error("Snapshot is corrupt: bad string");
+            }
+            Component component {};
+            component.*member = table[places[i]];
+            assigned.push_back(remap(owners[i]));
+            registry.assign<Component>(assigned.back(), std::move(component));
+        }
+        return assigned;
+    }
+
+    void save_route(writer& out, const te::route& the_route) {
+        out.put_string(the_route.name);
+        out.put<std::uint64_t>(the_route.stops.size());
+        for (const auto& stop : the_route.stops) {
+            out.put(stop.where);
+            out.put(stop.leave_with);
+        }
+    }
+
+    te::route load_route(reader& in, const entity_map& remap) {
+        te::route the_route { in.get_string(), {} };
+        const auto stops = in.get<std::uint64_t>();
+        for (std::uint64_t i = 0; i < stops; i++) {
+            const auto where = remap(in.get<entt::entity>());
+            the_route.stops.push_back(te::stop { where, in.get<te::per_commodity<int>>() });
+        }
+        return the_route;
+    }
+
+    void save_entities(writer& out, section part, const std::vector<entt::entity>& list) {
+        out.put(part);
+        out.put<std::uint64_t>(list.size());
+        out.put_column(list.data(), list.size());
+    }
+
+    std::vector<entt::entity> load_entities(reader& in, const entity_map& remap, section part) {
+        in.expect(part);
+        const auto count = in.get<std::uint64_t>();
+        const auto* saved = in.get_column<entt::entity>(count);
+        std::vector<entt::entity> list;
+        list.reserve(count);
+        for (std::size_t i = 0; i < count; i++) list.push_back(remap(saved[i]));
+        return list;
+    }
+}
+
+void te::save_snapshot(sim& model, const std::string& filename) {
+    writer out;
+    header head {};
+    std::memcpy(head.magic, snapshot_magic, sizeof(snapshot_magic));
+    head.version = snapshot_version;
+    head.seed = model.seed;
+    head.map_width = model.map_width;
+    head.map_height = model.map_height;
+    head.ticks = model.ticks;
+    head.time = model.time;
+    out.put(head);
+
+    auto& registry = model.entities;
+    std::vector<entt::entity> alive;
+    alive.reserve(registry.alive());
+    registry.each([&](entt::entity entity) { alive.push_back(entity); });
+    std::sort(alive.begin(), alive.end());
+    save_entities(out, section::entities, alive);
+    const auto destroyed = destroyed_entities(registry);
+    out.put<std::uint64_t>(destroyed.size());
+    out.put_column(destroyed.data(), destroyed.size());
+
+    string_table strings;
+    strings.add_all(registry, &named::name);
+    strings.add_all(registry, &render_mesh::filename);
+    strings.add_all(registry, &render_tex::filename);
+    save_string_table(out, strings);
+    save_interned(out, registry, section::named, strings, &named::name);
+    {
+        // in the same order as the names
+        auto view = registry.view<named>();
+        const entt::entity* owners = view.data();
+        std::vector<std::uint8_t> numbered;
+        numbered.reserve(view.size());
+        for (std::size_t i = 0; i < view.size(); i++) numbered.push_back(view.get(owners[i]).numbered);
+        out.put_column(numbered.data(), numbered.size());
+    }
+    save_column<price>(out, registry, section::price);
+    save_column<footprint>(out, registry, section::footprint);
+    save_column<site>(out, registry, section::site);
+    save_column<ghost>(out, registry, section::ghost);
+    save_column<dweller>(out, registry, section::dweller);
+    save_column<demander>(out, registry, section::demander);
+    save_column<trader>(out, registry, section::trader);
+    save_column<generator>(out, registry, section::generator);
+    save_column<producer>(out, registry, section::producer);
+    save_column<inventory>(out, registry, section::inventory);
+    {
+        auto markets = registry.view<market>();
+        const entt::entity* owners = markets.data();
+        std::vector<market_record> records;
+        records.reserve(markets.size());
+        for (std::size_t i = 0; i < markets.size(); i++) {
+            const auto& the_market = markets.get(owners[i]);
+            records.push_back(market_record {
+                the_market.prices,
+                the_market.commons,
+                the_market.radius,
+                the_market.growth_rate,
+                the_market.growth,
+                the_market.pending
+            });
+        }
+        out.put(section::market);
+        out.put<std::uint64_t>(markets.size());
+        out.put_column(owners, markets.size());
+        out.put_column(records.data(), records.size());
+    }
+    {
+        auto merchants = registry.view<merchant>();
+        const entt::entity* owners = merchants.data();
+        out.put(section::merchant);
+        out.put<std::uint64_t>(merchants.size());
+        out.put_column(owners, merchants.size());
+        for (std::size_t i = 0; i < merchants.size(); i++) {
+            const auto& the_merchant = merchants.get(owners[i]);
+            out.put<std::uint64_t>(the_merchant.last_stop);
+            out.put<std::uint8_t>(the_merchant.trading);
+            out.put(the_merchant.speed);
+            out.put<std::uint8_t>(the_merchant.route.has_value());
+            if (the_merchant.route) save_route(out, *the_merchant.route);
+        }
+    }
+    save_interned(out, registry, section::render_mesh, strings, &render_mesh::filename);
+    save_interned(out, registry, section::render_tex, strings, &render_tex::filename);
+    save_column<pickable>(out, registry, section::pickable);
+
+    out.put(section::families);
+    out.put<std::uint64_t>(model.families.size());
+    out.put_column(model.families.data(), model.families.size());
+    save_entities(out, section::commodities, model.commodities);
+    save_entities(out, section::blueprints, model.blueprints);
+    out.put(model.merchant_blueprint);
+    out.put(section::routes);
+    out.put<std::uint64_t>(model.routes.size());
+    for (const auto& the_route : model.routes) save_route(out, the_route);
+    out.put(section::lod);
+    out.put(lod_record {
+        model.lod.focus.has_value(),
+        model.lod.inspected.has_value(),
+        model.lod.stride,
+        model.lod.radius,
+        model.lod.focus.value_or(glm::vec2{0.0f, 0.0f}),
+        model.lod.inspected.value_or(glm::vec2{0.0f, 0.0f})
+    });
+    {
+        out.put(section::grid);
+        out.put<std::uint64_t>(model.grid.allocated_chunks());
+        for (std::size_t chunk_ix = 0; chunk_ix < model.grid.chunk_count(); chunk_ix++) {
+            if (auto owners = model.grid.chunk_owners(chunk_ix); owners) {
+                out.put<std::uint64_t>(chunk_ix);
+                out.put_column(owners, occupancy_grid::chunk_size * occupancy_grid::chunk_size);
+            }
+        }
+    }
+    out.put(section::membership);
+    out.put<std::uint64_t>(model.market_influencees.size());
+    for (const auto& [market_e, members] : model.market_influencees) {
+        out.put(market_e);
+        out.put<std::uint64_t>(members.size());
+        out.put_column(members.data(), members.size());
+    }
+
+    // write alongside and swap in, so a failed save doesn't destroy the last one
+    const std::string partial = filename + ".partial";
+    {
+        std::ofstream file { partial, std::ios::binary | std::ios::trunc };
+        file.write(out.contents().data(), out.contents().size());
+        if (!file) {
+            throw snapshot_error(fmt::format("Couldn't write {}", partial));
+        }
+    }
+    if (std::rename(partial.c_str(), filename.c_str()) != 0) {
+        throw snapshot_error(fmt::format("Couldn't replace {}: {}", filename, std::strerror(errno)));
+    }
+}
+
+std::unique_ptr<te::sim> te::load_snapshot(const std::string& filename, std::size_t threads) {
+    const mapped_file file { filename };
+    reader in { file.data(), file.size() };
+    const auto head = in.get<header>();
+    if (std::memcmp(head.magic, snapshot_magic, sizeof(snapshot_magic)) != 0) {
+        throw snapshot_error(fmt::format("{} isn't a snapshot", filename));
+    }
+    if (head.version != snapshot_version) {
+        throw snapshot_error(fmt::format("{} is snapshot version {}, expected {}", filename, head.version, snapshot_version));
+    }
+
+    world_params params;
+    params.map_width = head.map_width;
+    params.map_height = head.map_height;
+    params.threads = threads;
+    params.generate = false;
+    auto model = std::make_unique<sim>(head.seed, params);
+    model->ticks = head.ticks;
+    // before membership is rebuilt, which puts buildings back on their market's schedule
+    model->time = head.time;
+
+    auto& registry = model->entities;
+    in.expect(section::entities);
+    const auto alive_count = in.get<std::uint64_t>();
+    const auto* alive = in.get_column<entt::entity>(alive_count);
+    if (!std::is_sorted(alive, alive + alive_count)) {
+        throw snapshot_error("Snapshot is corrupt: entities out of order");
+    }
+    const auto destroyed_count = in.get<std::uint64_t>();
+    const auto* destroyed = in.get_column<entt::entity>(destroyed_count);
+    const entity_map remap { alive, alive_count, destroyed, destroyed_count, registry };
+
+    const auto strings = load_string_table(in);
+    {
+        const auto owners = load_interned(in, registry, remap, section::named, strings, &named::name);
+        const auto* numbered = in.get_column<std::uint8_t>(owners.size());
+        for (std::size_t i = 0; i < owners.size(); i++) registry.get<named>(owners[i]).numbered = numbered[i];
+    }
+    load_column<price>(in, registry, remap, section::price);
+    load_column<footprint>(in, registry, remap, section::footprint);
+    load_column<site>(in, registry, remap, section::site);
+    load_column<ghost>(in, registry, remap, section::ghost);
+    load_column<dweller>(in, registry, remap, section::dweller);
+    load_column<demander>(in, registry, remap, section::demander);
+    load_column<trader>(in, registry, remap, section::trader);
+    load_column<generator>(in, registry, remap, section::generator);
+    load_column<producer>(in, registry, remap, section::producer);
+    load_column<inventory>(in, registry, remap, section::inventory);
+    {
+        in.expect(section::market);
+        const auto count = in.get<std::uint64_t>();
+        const auto* owners = in.get_column<entt::entity>(count);
+        const auto* records = in.get_column<market_record>(count);
+        registry.reserve<market>(count);
+        for (std::size_t i = 0; i < count; i++) {
+            auto& the_market = registry.assign<market>(remap(owners[i]));
+            the_market.prices = records[i].prices;
+            the_market.commons = remap(records[i].commons);
+            the_market.radius = records[i].radius;
+            the_market.growth_rate = records[i].growth_rate;
+            the_market.growth = records[i].growth;
+            the_market.pending = records[i].pending;
+        }
+    }
+    {
+        in.expect(section::merchant);
+        const auto count = in.get<std::uint64_t>();
+        const auto* owners = in.get_column<entt::entity>(count);
+        std::vector<entt::entity> merchant_entities(owners, owners + count);
+        for (auto saved : merchant_entities) {
+            merchant the_merchant;
+            the_merchant.last_stop = in.get<std::uint64_t>();
+            the_merchant.trading = in.get<std::uint8_t>();
+            the_merchant.speed = in.get<float>();
+            if (in.get<std::uint8_t>()) the_merchant.route = load_route(in, remap);
+            registry.assign<merchant>(remap(saved), std::move(the_merchant));
+        }
+    }
+    load_interned(in, registry, remap, section::render_mesh, strings, &render_mesh::filename);
+    load_interned(in, registry, remap, section::render_tex, strings, &render_tex::filename);
+    load_column<pickable>(in, registry, remap, section::pickable);
+
+    in.expect(section::families);
+    const auto family_count = in.get<std::uint64_t>();
+    const auto* families = in.get_column<family>(family_count);
+    model->families.assign(families, families + family_count);
+    model->commodities = load_entities(in, remap, section::commodities);
+    model->blueprints = load_entities(in, remap, section::blueprints);
+    model->merchant_blueprint = remap(in.get<entt::entity>());
+    in.expect(section::routes);
+    const auto route_count = in.get<std::uint64_t>();
+    for (std::uint64_t i = 0; i < route_count; i++) {
+        model->routes.push_back(load_route(in, remap));
+    }
+    in.expect(section::lod);
+    {
+        const auto lod = in.get<lod_record>();
+        if (lod.has_focus) model->lod.focus = lod.focus;
+        if (lod.has_inspected) model->lod.inspected = lod.inspected;
+        model->lod.stride = lod.stride;
+        model->lod.radius = lod.radius;
+    }
+    {
+        in.expect(section::grid);
+        const auto chunk_count = in.get<std::uint64_t>();
+        std::vector<entt::entity> owners(occupancy_grid::chunk_size * occupancy_grid::chunk_size);
+        // buildings cover runs of cells, so most cells have the same owner as the one before
+        entt::entity last_saved = entt::null;
+        entt::entity last_loaded = entt::null;
+        for (std::uint64_t i = 0; i < chunk_count; i++) {
+            const auto chunk_ix = in.get<std::uint64_t>();
+            if (chunk_ix >= model->grid.chunk_count()) {
+                throw snapshot_error("Snapshot is corrupt: chunk off the map");
+            }
+            const auto* saved = in.get_column<entt::entity>(owners.size());
+            for (std::size_t cell = 0; cell < owners.size(); cell++) {
+                if (saved[cell] != last_saved) {
+                    last_saved = saved[cell];
+                    last_loaded = remap(last_saved);
+                }
+                owners[cell] = last_loaded;
+            }
+            model->grid.restore_chunk(chunk_ix, owners.data());
+        }
+    }
+    // add_member sets idle buildings looking for work, but these are to go on as they were saved
+    auto generators = registry.view<generator>();
+    auto producers = registry.view<producer>();
+    std::vector<std::optional<double>> generator_dues;
+    std::vector<std::optional<double>> producer_dues;
+    for (auto entity : generators) generator_dues.push_back(generators.get(entity).due);
+    for (auto entity : producers) producer_dues.push_back(producers.get(entity).due);
+    // membership goes through add_member so the market totals are rebuilt along with it
+    in.expect(section::membership);
+    const auto market_count = in.get<std::uint64_t>();
+    for (std::uint64_t i = 0; i < market_count; i++) {
+        const auto market_e = remap(in.get<entt::entity>());
+        const auto member_count = in.get<std::uint64_t>();
+        const auto* members = in.get_column<entt::entity>(member_count);
+        auto& influencees = model->market_influencees[market_e];
+        influencees.reserve(member_count);
+        for (std::size_t member_ix = 0; member_ix < member_count; member_ix++) {
+            model->add_member(market_e, remap(members[member_ix]));
+        }
+    }
+    // anything it put on a schedule as well is dropped when it comes up
+    std::size_t building_ix = 0;
+    for (auto entity : generators) generators.get(entity).due = generator_dues[building_ix++];
+    building_ix = 0;
+    for (auto entity : producers) producers.get(entity).due = producer_dues[building_ix++];
+    return model;
+}
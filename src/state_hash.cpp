@@ -0,0 +1,161 @@
+#include <te/state_hash.hpp>
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace {
+    // FNV-1a, fed field by field so that padding never gets in
+    class hasher {
+        std::uint64_t value = 0xcbf29ce484222325ull;
+    public:
+        void add_bytes(const void* data, std::size_t size) {
+            const auto* bytes = static_cast<const unsigned char*>(data);
+            for (std::size_t i = 0; i < size; i++) {
+                value = (value ^ bytes[i]) * 0x100000001b3ull;
+            }
+        }
+        template<typename T>
+        void add(const T& field) {
+            static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+            add_bytes(&field, sizeof(T));
+        }
+        void add(glm::vec2 field) {
+            add(field.x);
+            add(field.y);
+        }
+        void add(std::string_view field) {
+            add<std::uint64_t>(field.size());
+            add_bytes(field.data(), field.size());
+        }
+        template<typename T>
+        void add(const te::per_commodity<T>& field) {
+            for (const auto& each : field) add(each);
+        }
+        template<typename T>
+        void add(const std::optional<T>& field) {
+            add<std::uint8_t>(field.has_value());
+            if (field) add(*field);
+        }
+        std::uint64_t result() const {
+            return value;
+        }
+    };
+
+    std::vector<entt::entity> sorted(std::vector<entt::entity> entities) {
+        std::sort(entities.begin(), entities.end());
+        return entities;
+    }
+
+    // every entity with a component, in entity order, followed by its fields
+    template<typename Component, typename F>
+    void add_each(hasher& hash, entt::registry& registry, F&& add_fields) {
+        auto view = registry.view<Component>();
+        const auto owners = sorted({view.data(), view.data() + view.size()});
+        hash.add<std::uint64_t>(owners.size());
+        for (auto entity : owners) {
+            hash.add(entity);
+            if constexpr (!std::is_empty_v<Component>) add_fields(view.get(entity));
+        }
+    }
+
+    // entries still wanted, soonest first, which is the order they'll be run in
+    template<typename Work>
+    void add_schedule(hasher& hash, te::sim& model, entt::entity market_e, const te::work_schedule& schedule) {
+        schedule.each([&](entt::entity building_e, double due) {
+            if (!model.entities.valid(building_e) || !model.is_member(market_e, building_e)) return;
+            auto work = model.entities.try_get<Work>(building_e);
+            if (!work || work->due != due) return;
+            hash.add(building_e);
+            hash.add(due);
+        });
+    }
+}
+
+std::uint64_t te::state_hash(sim& model) {
+    hasher hash;
+    hash.add(model.seed);
+    hash.add(model.ticks);
+    hash.add(model.time);
+    for (const auto& the_family : model.families) hash.add(the_family.balance);
+
+    auto& registry = model.entities;
+    std::vector<entt::entity> alive;
+    alive.reserve(registry.alive());
+    registry.each([&](entt::entity entity) { alive.push_back(entity); });
+    for (auto entity : sorted(std::move(alive))) hash.add(entity);
+
+    add_each<named>(hash, registry, [&](const named& the_named) {
+        hash.add(std::string_view { str(the_named.name) });
+        hash.add(the_named.numbered);
+    });
+    add_each<price>(hash, registry, [&](const price& the_price) { hash.add(the_price.price); });
+    add_each<footprint>(hash, registry, [&](const footprint& print) { hash.add(print.dimensions); });
+    add_each<site>(hash, registry, [&](const site& the_site) { hash.add(the_site.position); });
+    add_each<ghost>(hash, registry, [&](const ghost& the_ghost) { hash.add(the_ghost.proto); });
+    add_each<dweller>(hash, registry, [](const dweller&) {});
+    add_each<demander>(hash, registry, [&](const demander& the_demander) { hash.add(the_demander.rate); });
+    add_each<trader>(hash, registry, [&](const trader& the_trader) {
+        hash.add(the_trader.family_ix);
+        hash.add(the_trader.bid);
+        hash.add(the_trader.balance);
+    });
+    add_each<generator>(hash, registry, [&](const generator& the_generator) {
+        hash.add(the_generator.output);
+        hash.add(the_generator.rate);
+        hash.add(the_generator.due);
+    });
+    add_each<producer>(hash, registry, [&](const producer& the_producer) {
+        hash.add(the_producer.inputs);
+        hash.add(the_producer.outputs);
+        hash.add(the_producer.rate);
+        hash.add(the_producer.producing);
+        hash.add(the_producer.due);
+    });
+    add_each<inventory>(hash, registry, [&](const inventory& the_inventory) { hash.add(the_inventory.stock); });
+    add_each<market>(hash, registry, [&](const market& the_market) {
+        hash.add(the_market.prices);
+        hash.add(the_market.demand);
+        hash.add(the_market.supply);
+        hash.add(the_market.demand_rate);
+        hash.add(the_market.commons);
+        hash.add(the_market.radius);
+        hash.add(the_market.population);
+        hash.add(the_market.growth_rate);
+        hash.add(the_market.growth);
+        hash.add(the_market.pending);
+    });
+    add_each<merchant>(hash, registry, [&](const merchant& the_merchant) {
+        hash.add(the_merchant.last_stop);
+        hash.add(the_merchant.trading);
+        hash.add(the_merchant.speed);
+        hash.add<std::uint8_t>(the_merchant.route.has_value());
+        if (the_merchant.route) {
+            for (const auto& the_stop : the_merchant.route->stops) {
+                hash.add(the_stop.where);
+                hash.add(the_stop.leave_with);
+            }
+        }
+    });
+
+    // members in the order they joined, which decides which dwellings go first
+    auto markets = registry.view<market>();
+    for (auto market_e : sorted({markets.data(), markets.data() + markets.size()})) {
+        hash.add(market_e);
+        for (auto member_e : model.members_of(market_e)) hash.add(member_e);
+        const auto& the_market = markets.get(market_e);
+        add_schedule<generator>(hash, model, market_e, the_market.generator_schedule);
+        add_schedule<producer>(hash, model, market_e, the_market.producer_schedule);
+    }
+
+    for (auto commodity : model.commodities) hash.add(commodity);
+    for (auto blueprint : model.blueprints) hash.add(blueprint);
+    hash.add(model.merchant_blueprint);
+    hash.add(model.lod.focus);
+    hash.add(model.lod.radius);
+    hash.add(model.lod.inspected);
+    hash.add(model.lod.stride);
+    return hash.result();
+}
@@ -0,0 +1,36 @@
+#include <te/step_clock.hpp>
+#include <cmath>
+
+double te::step_clock::step() const {
+    return 1.0 / tick_rate;
+}
+
+int te::step_clock::advance(double real_seconds) {
+    int steps = queued;
+    queued = 0;
+    if (paused) {
+        accumulator = 0.0;
+        return steps;
+    }
+    accumulator += real_seconds * speed * tick_rate;
+    const double whole = std::floor(accumulator);
+    accumulator -= whole;
+    steps += static_cast<int>(whole);
+    if (steps > max_catch_up) {
+        dropped_steps += steps - max_catch_up;
+        steps = max_catch_up;
+    }
+    return steps;
+}
+
+void te::step_clock::step_once() {
+    queued++;
+}
+
+double te::step_clock::lag() const {
+    return accumulator;
+}
+
+long te::step_clock::dropped() const {
+    return dropped_steps;
+}
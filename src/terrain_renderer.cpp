@@ -1,45 +1,30 @@
 #include <te/terrain_renderer.hpp>
-#include <te/util.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <spdlog/spdlog.h>
+#include <vector>
 
 namespace {
-    te::gl::buffer<GL_ARRAY_BUFFER> fill_grid(te::gl::context& gl, std::default_random_engine& rengine, int width, int height) {
-        static std::uniform_int_distribution tile_select {0, 3};
-        struct vertex {
-            glm::vec2 pos;
-            glm::vec3 col;
-            glm::vec2 uv;
-        };
-        static_assert(sizeof(vertex) == sizeof(GLfloat) * 7, "Platform doesn't support this directly.");
-        std::vector<vertex> data;
-        data.reserve(width * height * 6);
-        glm::vec2 grid_tl {-width/2.0f, -height/2.0f};
-        glm::vec3 white {1.0f, 1.0f, 1.0f};
-        for (int xi = 0; xi < width; xi++) {
-            for (int yi = 0; yi < height; yi++) {
-                glm::vec2 uv_tl {tile_select(rengine) * 0.25f, tile_select(rengine) * 0.25f};
-                auto cell_tl_pos = grid_tl + static_cast<float>(xi) * glm::vec2{1.0f, 0.0f}
-                                           + static_cast<float>(yi) * glm::vec2{0.0f, 1.0f};
-                vertex cell_tl {cell_tl_pos + glm::vec2{0.0f, 0.0f}, white, uv_tl + glm::vec2(0.0f, 0.0f)};
-                vertex cell_tr {cell_tl_pos + glm::vec2{1.0f, 0.0f}, white, uv_tl + glm::vec2(0.5f, 0.0f)};
-                vertex cell_br {cell_tl_pos + glm::vec2{1.0f, 1.0f}, white, uv_tl + glm::vec2(0.5f, 0.5f)};
-                vertex cell_bl {cell_tl_pos + glm::vec2{0.0f, 1.0f}, white, uv_tl + glm::vec2(0.0f, 0.5f)};
-                data.push_back(cell_tl);
-                data.push_back(cell_tr);
-                data.push_back(cell_br);
-                data.push_back(cell_br);
-                data.push_back(cell_bl);
-                data.push_back(cell_tl);
-            }
-        }
-        return gl.make_buffer<GL_ARRAY_BUFFER>(data.begin(), data.end());
+    struct vertex {
+        glm::vec2 pos;
+        glm::vec3 col;
+        glm::vec2 uv;
+    };
+    static_assert(sizeof(vertex) == sizeof(GLfloat) * 7, "Platform doesn't support this directly.");
+
+    // which of the 4x4 tiles in the texture a cell shows
+    glm::vec2 tile_uv(unsigned seed, int xi, int yi) {
+        // splitmix64 finaliser over the seed and position
+        std::uint64_t h = (std::uint64_t{seed} << 32) ^ (static_cast<std::uint64_t>(static_cast<std::uint32_t>(xi)) << 16)
+                        ^ static_cast<std::uint64_t>(static_cast<std::uint32_t>(yi)) * 0x9e3779b97f4a7c15ull;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+        h ^= h >> 31;
+        return glm::vec2{static_cast<float>(h & 3), static_cast<float>((h >> 2) & 3)} * 0.25f;
     }
 }
 
-te::terrain_renderer::terrain_renderer(gl::context& ogl, std::default_random_engine& rengine, int width, int height):
+te::terrain_renderer::terrain_renderer(gl::context& ogl, unsigned seed, int width, int height):
     gl(ogl),
-    vbo(fill_grid(gl, rengine, width, height)),
     program(gl.link(gl.compile(te::file_contents("shaders/terrain_vertex.glsl"), GL_VERTEX_SHADER),
                     gl.compile(te::file_contents("shaders/terrain_fragment.glsl"), GL_FRAGMENT_SHADER)).hnd),
     model_uniform(program.uniform("model")),
@@ -47,6 +32,7 @@ te::terrain_renderer::terrain_renderer(gl::context& ogl, std::default_random_eng
     proj_uniform(program.uniform("projection")),
     sampler(gl.make_sampler()),
     texture(gl.make_texture("tiles.png")),
+    seed(seed),
     width(width),
     height(height),
     grid_topleft{-width/2.0f, -height/2.0f, 0.0f}
@@ -54,15 +40,47 @@ te::terrain_renderer::terrain_renderer(gl::context& ogl, std::default_random_eng
     glUseProgram(*program.hnd);
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
-    GLint pos_attrib = program.find_attribute("position").value();
+    pos_attrib = program.find_attribute("position").value();
     glEnableVertexAttribArray(pos_attrib);
-    glVertexAttribPointer(pos_attrib, 2, GL_FLOAT, GL_FALSE, 7*sizeof(float), reinterpret_cast<void*>(0));
-    GLint col_attrib = program.find_attribute("colour").value();
+    col_attrib = program.find_attribute("colour").value();
     glEnableVertexAttribArray(col_attrib);
-    glVertexAttribPointer(col_attrib, 3, GL_FLOAT, GL_FALSE, 7*sizeof(float), reinterpret_cast<void*>(2*sizeof(float)));
-    GLint tex_attrib = program.find_attribute("texcoord").value();
+    tex_attrib = program.find_attribute("texcoord").value();
     glEnableVertexAttribArray(tex_attrib);
-    glVertexAttribPointer(tex_attrib, 2, GL_FLOAT, GL_FALSE, 7*sizeof(float), reinterpret_cast<void*>(5*sizeof(float)));
+}
+
+glm::ivec2 te::terrain_renderer::chunk_extent(glm::ivec2 chunk) const {
+    return glm::min(glm::ivec2{chunk_size, chunk_size}, glm::ivec2{width, height} - chunk * chunk_size);
+}
+
+te::gl::buffer<GL_ARRAY_BUFFER>& te::terrain_renderer::chunk_at(glm::ivec2 chunk) {
+    if (auto it = chunks.find(chunk); it != chunks.end()) {
+        return it->second;
+    }
+    const glm::ivec2 first = chunk * chunk_size;
+    const glm::ivec2 extent = chunk_extent(chunk);
+    std::vector<vertex> data;
+    data.reserve(extent.x * extent.y * 6);
+    glm::vec2 grid_tl {grid_topleft.x, grid_topleft.y};
+    glm::vec3 white {1.0f, 1.0f, 1.0f};
+    for (int xi = first.x; xi < first.x + extent.x; xi++) {
+        for (int yi = first.y; yi < first.y + extent.y; yi++) {
+            glm::vec2 uv_tl = tile_uv(seed, xi, yi);
+            auto cell_tl_pos = grid_tl + static_cast<float>(xi) * glm::vec2{1.0f, 0.0f}
+                                       + static_cast<float>(yi) * glm::vec2{0.0f, 1.0f};
+            vertex cell_tl {cell_tl_pos + glm::vec2{0.0f, 0.0f}, white, uv_tl + glm::vec2(0.0f, 0.0f)};
+            vertex cell_tr {cell_tl_pos + glm::vec2{1.0f, 0.0f}, white, uv_tl + glm::vec2(0.5f, 0.0f)};
+            vertex cell_br {cell_tl_pos + glm::vec2{1.0f, 1.0f}, white, uv_tl + glm::vec2(0.5f, 0.5f)};
+            vertex cell_bl {cell_tl_pos + glm::vec2{0.0f, 1.0f}, white, uv_tl + glm::vec2(0.0f, 0.5f)};
+            data.push_back(cell_tl);
+            data.push_back(cell_tr);
+            data.push_back(cell_br);
+            data.push_back(cell_br);
+            data.push_back(cell_bl);
+            data.push_back(cell_tl);
+        }
+    }
+    spdlog::debug("Built terrain chunk ({}, {})", chunk.x, chunk.y);
+    return chunks.emplace(chunk, gl.make_buffer<GL_ARRAY_BUFFER>(data.begin(), data.end())).first->second;
 }
 
 void te::terrain_renderer::render(const te::camera& cam) {
@@ -75,6 +93,22 @@ void te::terrain_renderer::render(const te::camera& cam) {
 
     sampler.bind(0);
     texture.activate(0);
-    
-    glDrawArrays(GL_TRIANGLES, 0, width * height * 6);
+
+    // generous bound on how much ground the camera can see from where it is
+    const float reach = 2.0f * (cam.zoom_factor + glm::length(cam.eye() - cam.focus));
+    const glm::vec2 focus { cam.focus.x - grid_topleft.x, cam.focus.y - grid_topleft.y };
+    const glm::ivec2 last_chunk = (glm::ivec2{width, height} - 1) / chunk_size;
+    const glm::ivec2 first = glm::clamp(glm::ivec2{glm::floor((focus - reach) / static_cast<float>(chunk_size))}, glm::ivec2{0}, last_chunk);
+    const glm::ivec2 last = glm::clamp(glm::ivec2{glm::floor((focus + reach) / static_cast<float>(chunk_size))}, glm::ivec2{0}, last_chunk);
+    for (int cy = first.y; cy <= last.y; cy++) {
+        for (int cx = first.x; cx <= last.x; cx++) {
+            const glm::ivec2 chunk { cx, cy };
+            chunk_at(chunk).bind();
+            glVertexAttribPointer(pos_attrib, 2, GL_FLOAT, GL_FALSE, 7*sizeof(float), reinterpret_cast<void*>(0));
+            glVertexAttribPointer(col_attrib, 3, GL_FLOAT, GL_FALSE, 7*sizeof(float), reinterpret_cast<void*>(2*sizeof(float)));
+            glVertexAttribPointer(tex_attrib, 2, GL_FLOAT, GL_FALSE, 7*sizeof(float), reinterpret_cast<void*>(5*sizeof(float)));
+            const glm::ivec2 extent = chunk_extent(chunk);
+            glDrawArrays(GL_TRIANGLES, 0, extent.x * extent.y * 6);
+        }
+    }
 }
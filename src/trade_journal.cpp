@@ -0,0 +1,198 @@
+#include <te/trade_journal.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+namespace {
+    constexpr char journal_magic[8] = {'t', 'e', 't', 'r', 'a', 'd', 'e', '\0'};
+    // how long the writer sleeps when there isn't a whole segment to write
+    constexpr std::chrono::milliseconds writer_idle { 2 };
+
+    struct header {
+        char magic[8];
+        std::uint32_t version;
+    };
+
+    // the bytes of one trade across all the columns
+    constexpr std::size_t trade_bytes =
+        sizeof(std::int64_t) + 3 * sizeof(entt::entity) + sizeof(std::uint32_t) + sizeof(int) + sizeof(double);
+
+    template<typename T>
+    void put(std::ofstream& file, const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // count values of a column starting at index first of the ring, which may wrap around its end
+    template<typename T>
+    void put_column(std::ofstream& file, const T* column, std::size_t capacity, std::size_t first, std::size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const std::size_t before_end = std::min(count, capacity - first);
+        file.write(reinterpret_cast<const char*>(column + first), before_end * sizeof(T));
+        file.write(reinterpret_cast<const char*>(column), (count - before_end) * sizeof(T));
+    }
+
+    template<typename T>
+    void get_column(const char*& at, std::vector<te::trade>& trades, std::size_t first, T te::trade::* member) {
+        for (std::size_t i = first; i < trades.size(); i++) {
+            std::memcpy(&(trades[i].*member), at, sizeof(T));
+            at += sizeof(T);
+        }
+    }
+}
+
+te::trade_journal::trade_journal(std::size_t capacity) :
+    capacity_ { std::max<std::size_t>(1, (capacity + segment_size - 1) / segment_size) * segment_size },
+    ticks { new std::int64_t[capacity_] },
+    markets { new entt::entity[capacity_] },
+    commodities { new std::uint32_t[capacity_] },
+    buyers { new entt::entity[capacity_] },
+    sellers { new entt::entity[capacity_] },
+    quantities { new int[capacity_] },
+    prices { new double[capacity_] }
+{
+}
+
+te::trade_journal::~trade_journal() {
+    if (writer.joinable()) {
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+    }
+}
+
+void te::trade_journal::write_to(const std::string& filename) {
+    if (writer.joinable()) {
+        throw trade_journal_error("Trade journal is already being written");
+    }
+    file.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw trade_journal_error(fmt::format("Couldn't open {} for writing", filename));
+    }
+    header start {};
+    std::memcpy(start.magic, journal_magic, sizeof(journal_magic));
+    start.version = trade_journal_version;
+    put(file, start);
+    const std::uint64_t appended = head.load(std::memory_order_relaxed);
+    tail.store(appended - std::min<std::uint64_t>(appended, capacity_), std::memory_order_relaxed);
+    writer = std::thread { [this]() { write_segments(); } };
+}
+
+void te::trade_journal::write_segments() {
+    std::uint64_t written = tail.load(std::memory_order_relaxed);
+    while (true) {
+        // read before the head, so that nothing appended after it's seen is left behind
+        const bool last = stopping.load(std::memory_order_acquire);
+        const std::uint64_t appended = head.load(std::memory_order_acquire);
+        // whole segments as they fill, and whatever is left at the end
+        while (appended - written >= segment_size || (last && appended > written)) {
+            const auto count = static_cast<std::size_t>(std::min<std::uint64_t>(appended - written, segment_size));
+            const auto first = static_cast<std::size_t>(written % capacity_);
+            put(file, static_cast<std::uint32_t>(count));
+            put_column(file, ticks.get(), capacity_, first, count);
+            put_column(file, markets.get(), capacity_, first, count);
+            put_column(file, commodities.get(), capacity_, first, count);
+            put_column(file, buyers.get(), capacity_, first, count);
+            put_column(file, sellers.get(), capacity_, first, count);
+            put_column(file, quantities.get(), capacity_, first, count);
+            put_column(file, prices.get(), capacity_, first, count);
+            written += count;
+            // hands the slots back to append
+            tail.store(written, std::memory_order_release);
+        }
+        if (last) break;
+        file.flush();
+        std::this_thread::sleep_for(writer_idle);
+    }
+    file.flush();
+    if (!file) {
+        spdlog::error("Couldn't write the trade journal; it may be incomplete");
+    }
+}
+
+void te::trade_journal::append(const trade& the_trade) {
+    const std::uint64_t at = head.load(std::memory_order_relaxed);
+    if (writer.joinable() && at - tail.load(std::memory_order_acquire) >= capacity_) {
+        dropped_++;
+        return;
+    }
+    const auto slot = static_cast<std::size_t>(at % capacity_);
+    ticks[slot] = the_trade.tick;
+    markets[slot] = the_trade.market;
+    commodities[slot] = the_trade.commodity;
+    buyers[slot] = the_trade.buyer;
+    sellers[slot] = the_trade.seller;
+    quantities[slot] = the_trade.quantity;
+    prices[slot] = the_trade.price;
+    // publishes the slot to the writer
+    head.store(at + 1, std::memory_order_release);
+}
+
+std::size_t te::trade_journal::capacity() const {
+    return capacity_;
+}
+
+std::uint64_t te::trade_journal::appended() const {
+    return head.load(std::memory_order_relaxed);
+}
+
+std::uint64_t te::trade_journal::dropped() const {
+    return dropped_;
+}
+
+std::size_t te::trade_journal::retained() const {
+    return static_cast<std::size_t>(std::min<std::uint64_t>(appended(), capacity_));
+}
+
+te::trade te::trade_journal::operator[](std::size_t i) const {
+    const auto slot = static_cast<std::size_t>((appended() - retained() + i) % capacity_);
+    return trade { ticks[slot], markets[slot], commodities[slot], buyers[slot], sellers[slot], quantities[slot], prices[slot] };
+}
+
+std::vector<te::trade> te::read_trade_journal(const std::string& filename) {
+    std::ifstream file { filename, std::ios::binary };
+    if (!file) {
+        throw trade_journal_error(fmt::format("Couldn't open {}", filename));
+    }
+    const std::vector<char> bytes { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+    header head {};
+    if (bytes.size() >= sizeof(head)) {
+        std::memcpy(&head, bytes.data(), sizeof(head));
+    }
+    if (std::memcmp(head.magic, journal_magic, sizeof(journal_magic)) != 0) {
+        throw trade_journal_error(fmt::format("{} isn't a trade journal", filename));
+    }
+    if (head.version != trade_journal_version) {
+        throw trade_journal_error(fmt::format("{} is trade journal version {}, expected {}", filename, head.version, trade_journal_version));
+    }
+    std::vector<trade> trades;
+    const char* at = bytes.data() + sizeof(head);
+    const char* const end = bytes.data() + bytes.size();
+    while (at != end) {
+        std::uint32_t count;
+        if (static_cast<std::size_t>(end - at) < sizeof(count)) {
+            spdlog::warn("{} ends part way through a segment, ignoring it", filename);
+            break;
+        }
+        std::memcpy(&count, at, sizeof(count));
+        at += sizeof(count);
+        if (static_cast<std::size_t>(end - at) < count * trade_bytes) {
+            spdlog::warn("{} ends part way through a segment, ignoring it", filename);
+            break;
+        }
+        const std::size_t first = trades.size();
+        trades.resize(first + count);
+        get_column(at, trades, first, &trade::tick);
+        get_column(at, trades, first, &trade::market);
+        get_column(at, trades, first, &trade::commodity);
+        get_column(at, trades, first, &trade::buyer);
+        get_column(at, trades, first, &trade::seller);
+        get_column(at, trades, first, &trade::quantity);
+        get_column(at, trades, first, &trade::price);
+    }
+    return trades;
+}
@@ -21,8 +21,9 @@ std::size_t std::hash<glm::vec2>::operator()(glm::vec2 xy) const {
     return hash_x ^ (hash_y << 1);
 };
 
-std::size_t std::hash<glm::ivec2>::operator()(glm::vec2 xy) const {
-    std::size_t hash_x = std::hash<int>{}(xy.x);
-    std::size_t hash_y = std::hash<int>{}(xy.y);
-    return hash_x ^ (hash_y << 1);
+std::size_t std::hash<glm::ivec2>::operator()(glm::ivec2 xy) const {
+    // large odd multipliers spread neighbouring cells apart, unlike a plain xor
+    std::size_t hash_x = std::hash<int>{}(xy.x) * 73856093u;
+    std::size_t hash_y = std::hash<int>{}(xy.y) * 19349663u;
+    return hash_x ^ hash_y;
 }
@@ -0,0 +1,75 @@
+#include <te/worker_pool.hpp>
+
+te::worker_pool::worker_pool(std::size_t threads) {
+    // the thread calling run() does its share too
+    for (std::size_t i = 1; i < threads; i++) {
+        workers.emplace_back([this] { work(); });
+    }
+}
+
+te::worker_pool::~worker_pool() {
+    {
+        std::lock_guard lock { mutex };
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+std::size_t te::worker_pool::size() const {
+    return workers.size() + 1;
+}
+
+void te::worker_pool::drain(const std::function<void(std::size_t)>& task, std::size_t count) {
+    std::size_t done = 0;
+    for (std::size_t i = next_task++; i < count; i = next_task++) {
+        task(i);
+        done++;
+    }
+    std::lock_guard lock { mutex };
+    finished += done;
+}
+
+void te::worker_pool::work() {
+    std::uint64_t seen = 0;
+    while (true) {
+        std::unique_lock lock { mutex };
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+        const auto& task = *job;
+        const auto count = job_count;
+        busy++;
+        lock.unlock();
+
+        drain(task, count);
+
+        lock.lock();
+        busy--;
+        lock.unlock();
+        idle.notify_all();
+    }
+}
+
+void te::worker_pool::run(std::size_t count, const std::function<void(std::size_t)>& task) {
+    if (workers.empty()) {
+        for (std::size_t i = 0; i < count; i++) task(i);
+        return;
+    }
+    {
+        std::unique_lock lock { mutex };
+        // a worker that woke late for the previous job may still be looking at it
+        idle.wait(lock, [&] { return busy == 0; });
+        job = &task;
+        job_count = count;
+        next_task = 0;
+        finished = 0;
+        generation++;
+    }
+    wake.notify_all();
+    drain(task, count);
+    std::unique_lock lock { mutex };
+    idle.wait(lock, [&] { return finished == count && busy == 0; });
+}
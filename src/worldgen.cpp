@@ -0,0 +1,120 @@
+#include <te/worldgen.hpp>
+#include <random>
+#include <cstdint>
+#include <algorithm>
+
+namespace {
+    // darts thrown for each building before giving up on it
+    constexpr int max_darts = 30;
+
+    glm::vec2 centre_of(glm::ivec2 topleft, glm::ivec2 dimensions) {
+        return glm::vec2{topleft} + glm::vec2{dimensions} / 2.0f;
+    }
+}
+
+te::world_tiling::world_tiling(glm::ivec2 map_dimensions, int tile_size) :
+    map_topleft { -map_dimensions / 2 },
+    map_dimensions { map_dimensions },
+    tile_size { tile_size },
+    counts { (map_dimensions + tile_size - 1) / tile_size }
+{
+}
+
+std::size_t te::world_tiling::size() const {
+    return static_cast<std::size_t>(counts.x) * counts.y;
+}
+
+std::pair<glm::ivec2, glm::ivec2> te::world_tiling::tile(std::size_t tile_ix) const {
+    const glm::ivec2 index { static_cast<int>(tile_ix % counts.x), static_cast<int>(tile_ix / counts.x) };
+    const glm::ivec2 offset = index * tile_size;
+    return { map_topleft + offset, glm::min(glm::ivec2{tile_size, tile_size}, map_dimensions - offset) };
+}
+
+int te::world_tiling::share(std::size_t tile_ix, int total) const {
+    // tiles are laid out row by row, so the area before a tile is quick to work out
+    auto area_before = [&](std::size_t ix) {
+        const std::int64_t row = ix / counts.x;
+        const std::int64_t column = ix % counts.x;
+        const std::int64_t full_rows = std::min<std::int64_t>(row * tile_size, map_dimensions.y) * map_dimensions.x;
+        const std::int64_t row_height = std::min(tile_size, map_dimensions.y - static_cast<int>(row) * tile_size);
+        return full_rows + std::min<std::int64_t>(column * tile_size, map_dimensions.x) * row_height;
+    };
+    const std::int64_t map_area = std::int64_t{map_dimensions.x} * map_dimensions.y;
+    // whole numbers of a running total, so the shares always add up to it
+    const auto upto = [&](std::size_t ix) { return total * area_before(ix) / map_area; };
+    return static_cast<int>(upto(tile_ix + 1) - upto(tile_ix));
+}
+
+te::tile_plan te::plan_tile (
+    const std::vector<blueprint_shape>& shapes,
+    glm::ivec2 topleft,
+    glm::ivec2 dimensions,
+    int count,
+    int spacing,
+    unsigned seed,
+    std::size_t tile_ix
+) {
+    tile_plan plan;
+    std::seed_seq seeds { seed, static_cast<unsigned>(tile_ix), static_cast<unsigned>(tile_ix >> 32) };
+    std::mt19937 rengine { seeds };
+    std::vector<double> weights;
+    for (const auto& shape : shapes) weights.push_back(shape.weight);
+    std::discrete_distribution<std::size_t> select_blueprint (weights.begin(), weights.end());
+
+    // cells taken within the tile
+    std::vector<std::uint8_t> taken(static_cast<std::size_t>(dimensions.x) * dimensions.y, 0);
+    auto is_clear = [&](glm::ivec2 local, glm::ivec2 print) {
+        const glm::ivec2 begin = glm::max(local - spacing, glm::ivec2{0});
+        const glm::ivec2 end = glm::min(local + print + spacing, dimensions);
+        for (int y = begin.y; y < end.y; y++) {
+            for (int x = begin.x; x < end.x; x++) {
+                if (taken[static_cast<std::size_t>(y) * dimensions.x + x]) return false;
+            }
+        }
+        return true;
+    };
+    std::vector<std::size_t> markets;
+
+    for (int i = 0; i < count; i++) {
+        const std::size_t blueprint_ix = select_blueprint(rengine);
+        const auto& shape = shapes[blueprint_ix];
+        // centres must keep half a cell more than the radius from the edge, so that markets in
+        // neighbouring tiles are strictly further apart than the sum of their radii
+        const float margin = shape.market_radius ? static_cast<float>(*shape.market_radius) + 0.5f : 0.0f;
+        const glm::ivec2 first = glm::ivec2{glm::ceil(glm::vec2{margin} - glm::vec2{shape.dimensions} / 2.0f)};
+        const glm::ivec2 lowest = glm::max(first, glm::ivec2{0});
+        const glm::ivec2 highest = glm::min (
+            glm::ivec2{glm::floor(glm::vec2{dimensions} - margin - glm::vec2{shape.dimensions} / 2.0f)},
+            dimensions - shape.dimensions
+        );
+        if (lowest.x > highest.x || lowest.y > highest.y) continue;
+        std::uniform_int_distribution select_x { lowest.x, highest.x };
+        std::uniform_int_distribution select_y { lowest.y, highest.y };
+
+        for (int dart = 0; dart < max_darts; dart++) {
+            const glm::ivec2 local { select_x(rengine), select_y(rengine) };
+            if (!is_clear(local, shape.dimensions)) continue;
+            const glm::vec2 centre = centre_of(local, shape.dimensions);
+            if (shape.market_radius) {
+                const bool conflict = std::any_of (
+                    markets.begin(),
+                    markets.end(),
+                    [&](std::size_t other_ix) {
+                        const auto& other = plan.buildings[other_ix];
+                        const auto& other_shape = shapes[other.blueprint_ix];
+                        return glm::length(centre - centre_of(other.topleft - topleft, other_shape.dimensions))
+                            <= *shape.market_radius + *other_shape.market_radius;
+                    }
+                );
+                if (conflict) continue;
+                markets.push_back(plan.buildings.size());
+            }
+            for (int y = local.y; y < local.y + shape.dimensions.y; y++) {
+                std::fill_n(taken.begin() + static_cast<std::size_t>(y) * dimensions.x + local.x, shape.dimensions.x, 1);
+            }
+            plan.buildings.push_back(planned_building { blueprint_ix, topleft + local });
+            break;
+        }
+    }
+    return plan;
+}